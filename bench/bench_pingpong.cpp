@@ -0,0 +1,90 @@
+#include <print>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "asyncio.hpp"
+using namespace kwa;
+
+
+constexpr size_t ROUND_NUM = 20'000;
+constexpr auto BUSY_POLL = std::chrono::microseconds(200);
+
+
+static asyncio::Task<> server(short port) {
+    asyncio::Socket s;
+    if (s.reuse_port() == -1 || s.bind("127.0.0.1", port) == -1 || s.listen(1) == -1) {
+        std::println("failed to listen on port {}", port);
+        co_return;
+    }
+    asyncio::Socket conn { co_await s.accept() };
+    char byte;
+    for (size_t i = 0; i < ROUND_NUM; ++i) {
+        if (!co_await conn.read(&byte, 1) || !co_await conn.write(&byte, 1)) {
+            break;
+        }
+    }
+    close(conn.fd());
+}
+
+
+static asyncio::Task<std::vector<double>> client(short port) {
+    std::vector<double> rtts;
+    rtts.reserve(ROUND_NUM);
+    asyncio::Socket s;
+    if (co_await s.connect("127.0.0.1", port) == -1) {
+        std::println("failed to connect port {}", port);
+        co_return rtts;
+    }
+    char byte = 'x';
+    for (size_t i = 0; i < ROUND_NUM; ++i) {
+        auto start = asyncio::Clock::now();
+        if (!co_await s.write(&byte, 1) || !co_await s.read(&byte, 1)) {
+            break;
+        }
+        auto end = asyncio::Clock::now();
+        rtts.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    co_return rtts;
+}
+
+
+/// server and client run on their own thread and loop, so every round trip
+/// wakes each loop once
+static void bench(const char* mode, short port, std::chrono::microseconds busy_poll) {
+    std::jthread server_thread([port, busy_poll] {
+        asyncio::EventLoop::get().set_busy_poll(busy_poll);
+        asyncio::run(server(port));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::vector<double> rtts;
+    std::jthread client_thread([port, busy_poll, &rtts] {
+        asyncio::EventLoop::get().set_busy_poll(busy_poll);
+        rtts = asyncio::run(client(port));
+    });
+    client_thread.join();
+    server_thread.join();
+    if (rtts.empty()) {
+        return;
+    }
+    std::ranges::sort(rtts);
+    auto percentile = [&rtts](double p) {
+        return rtts[std::min(rtts.size() - 1, size_t(rtts.size() * p))];
+    };
+    // one round trip is two wakeups
+    std::println(
+        "{:<10} rtt p50 {:>7.2f} us p99 {:>7.2f} us | wakeup p50 {:>7.2f} us p99 {:>7.2f} us",
+        mode,
+        percentile(0.5),
+        percentile(0.99),
+        percentile(0.5) / 2,
+        percentile(0.99) / 2
+    );
+}
+
+
+int main() {
+    spdlog::set_level(spdlog::level::warn);
+    bench("parked", 23470, std::chrono::microseconds(0));
+    bench("busy-poll", 23471, BUSY_POLL);
+}
@@ -0,0 +1,110 @@
+#include <print>
+#include <thread>
+#include <string>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "asyncio.hpp"
+using namespace kwa;
+
+
+constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+
+static asyncio::Task<> send_read_write(asyncio::Socket& conn, int file, size_t size) {
+    auto buffer = std::make_unique<char[]>(CHUNK_SIZE);
+    size_t sent = 0;
+    while (sent < size) {
+        auto nbytes = pread(file, buffer.get(), std::min(CHUNK_SIZE, size - sent), sent);
+        if (nbytes <= 0 || !co_await conn.write(buffer.get(), nbytes)) {
+            break;
+        }
+        sent += nbytes;
+    }
+}
+
+
+static asyncio::Task<> send_sendfile(asyncio::Socket& conn, int file, size_t size) {
+    if (auto res = co_await conn.sendfile(file, 0, size); !res) {
+        std::println("sendfile failed: {}", res.error());
+    }
+}
+
+
+static asyncio::Task<> server(short port, int file, size_t size, bool zero_copy) {
+    asyncio::Socket s;
+    if (s.reuse_port() == -1 || s.bind("127.0.0.1", port) == -1 || s.listen(1) == -1) {
+        std::println("failed to listen on port {}", port);
+        co_return;
+    }
+    asyncio::Socket conn { co_await s.accept() };
+    if (zero_copy) {
+        co_await send_sendfile(conn, file, size);
+    } else {
+        co_await send_read_write(conn, file, size);
+    }
+    close(conn.fd());
+}
+
+
+static asyncio::Task<size_t> client(short port) {
+    asyncio::Socket s;
+    if (co_await s.connect("127.0.0.1", port) == -1) {
+        std::println("failed to connect port {}", port);
+        co_return 0;
+    }
+    auto buffer = std::make_unique<char[]>(CHUNK_SIZE);
+    size_t received = 0;
+    while (true) {
+        auto res = co_await s.read(buffer.get(), CHUNK_SIZE);
+        if (!res) {
+            break;
+        }
+        received += *res;
+    }
+    co_return received;
+}
+
+
+/// server and client run on their own thread and loop, the client only
+/// drains the socket so the server side dominates the cost
+static void bench(const char* mode, short port, int file, size_t size, bool zero_copy) {
+    auto start = asyncio::Clock::now();
+    std::jthread server_thread([=] {
+        asyncio::run(server(port, file, size, zero_copy));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    size_t received = 0;
+    std::jthread client_thread([port, &received] {
+        received = asyncio::run(client(port));
+    });
+    client_thread.join();
+    server_thread.join();
+    auto seconds = std::chrono::duration<double>(asyncio::Clock::now() - start).count() - 0.05;
+    std::println(
+        "{:<12} {:>6.2f} GiB in {:>6.3f} s, {:>8.1f} MiB/s",
+        mode,
+        received / double(1 << 30),
+        seconds,
+        received / double(1 << 20) / seconds
+    );
+}
+
+
+/// usage: bench_sendfile [GiB], the file is sparse so that reading it is
+/// served from the page cache and only the copy to the socket is measured
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::warn);
+    size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2) << 30;
+    char path[] = "/tmp/bench_sendfile_XXXXXX";
+    int file = mkstemp(path);
+    if (file == -1 || ftruncate(file, size) == -1) {
+        std::println("failed to create a {} bytes file", size);
+        return 1;
+    }
+    unlink(path);
+    bench("read+write", 23480, file, size, false);
+    bench("sendfile", 23481, file, size, true);
+    close(file);
+}
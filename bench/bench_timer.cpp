@@ -0,0 +1,84 @@
+#include <print>
+#include <random>
+
+#include "asyncio.hpp"
+using namespace kwa;
+
+
+constexpr size_t TIMER_NUM = 1'000'000;
+// deadlines are spread over one minute
+constexpr int64_t SPREAD_MS = 60'000;
+
+
+template<typename F>
+static double measure(F&& f) {
+    auto start = asyncio::Clock::now();
+    f();
+    auto end = asyncio::Clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+
+static void report(const char* backend, const char* op, double seconds) {
+    std::println(
+        "{:<6} {:<7} {:>8.3f} ms {:>10.2f} Mops/s",
+        backend,
+        op,
+        seconds * 1000,
+        TIMER_NUM / seconds / 1e6
+    );
+}
+
+
+struct Node final: asyncio::TimerNode {
+    void set_when(asyncio::TimePoint when) noexcept { _when = when; }
+    void expire() noexcept override {}
+};
+
+
+template<typename Queue>
+static void bench(const char* backend) {
+    std::mt19937_64 rng { 42 };
+    std::uniform_int_distribution<int64_t> dist { 1, SPREAD_MS };
+    auto nodes = std::make_unique<Node[]>(TIMER_NUM);
+    std::vector<asyncio::TimerNode*> expired;
+    expired.reserve(TIMER_NUM);
+
+    Queue queue;
+    auto now = asyncio::Clock::now();
+    auto schedule = [&] {
+        for (size_t i = 0; i < TIMER_NUM; ++i) {
+            nodes[i].set_when(now + std::chrono::milliseconds(dist(rng)));
+            queue.push(nodes[i]);
+        }
+    };
+
+    report(backend, "insert", measure(schedule));
+    report(backend, "cancel", measure([&] {
+        for (size_t i = 0; i < TIMER_NUM; ++i) {
+            queue.cancel(nodes[i]);
+        }
+        // the heap drops tombstones here
+        (void)queue.next_when();
+    }));
+
+    schedule();
+    size_t fired = 0;
+    report(backend, "expire", measure([&] {
+        // the wheel rounds deadlines up to the next tick
+        for (int64_t ms = 0; ms <= SPREAD_MS + 1; ++ms) {
+            queue.pop_expired(now + std::chrono::milliseconds(ms), expired);
+            fired += expired.size();
+            expired.clear();
+        }
+    }));
+    if (fired != TIMER_NUM) {
+        std::println("{}: only {} of {} timers fired", backend, fired, TIMER_NUM);
+    }
+}
+
+
+int main() {
+    bench<asyncio::TimerHeap>("heap");
+    bench<asyncio::TimerWheel>("wheel");
+}
@@ -1,9 +1,24 @@
 #pragma once
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+
+#include <spdlog/spdlog.h>
+
 #include "asyncio_ns.hpp"
 #include "asyncio/event_loop.hpp"
 #include "asyncio/task.hpp"
+#include "asyncio/lazy_task.hpp"
+#include "asyncio/task_group.hpp"
+#include "asyncio/frame_pool.hpp"
+#include "asyncio/arena.hpp"
 #include "asyncio/socket.hpp"
+#include "asyncio/stream.hpp"
+#include "asyncio/relay.hpp"
 #include "asyncio/timer.hpp"
+#include "asyncio/timer_queue.hpp"
 #include "asyncio/sleep.hpp"
 #include "asyncio/future_awaiter.hpp"
 #include "asyncio/locks.hpp"
@@ -23,30 +38,89 @@ inline decltype(auto) run(T&& task) {
 }
 
 
+/// thread-per-core mode: start `shards` threads, each owning its own event loop,
+/// epoll instance, timers and handles, and run `factory(shard)` as root task on it.
+/// shard `i` is pinned to the `i`-th cpu the process may run on, wrapping around
+template<typename F>
+requires concepts::Task<std::invoke_result_t<F&, size_t>>
+auto run_sharded(size_t shards, F&& factory) {
+    using result_type = std::invoke_result_t<F&, size_t>::result_type;
+    constexpr bool has_result = !std::is_void_v<result_type>;
+    struct Empty {};
+    std::vector<std::conditional_t<has_result, std::optional<result_type>, Empty>> results(shards);
+    std::vector<std::jthread> threads;
+    threads.reserve(shards);
+    // a restricted cpuset may not start at cpu 0 nor be contiguous
+    std::vector<int> cpus;
+    if (cpu_set_t allowed; sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    for (size_t i = 0; i < shards; ++i) {
+        threads.emplace_back([&factory, &results, i] {
+            if constexpr (has_result) {
+                results[i].emplace(run(factory(i)));
+            } else {
+                run(factory(i));
+            }
+        });
+        if (cpus.empty()) {
+            continue;
+        }
+        auto cpu = cpus[i % cpus.size()];
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if (auto err = pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpuset), &cpuset); err != 0) {
+            SPDLOG_WARN("failed to pin shard {} to cpu {}: {}", i, cpu, strerror(err));
+        }
+    }
+    threads.clear();
+    if constexpr (has_result) {
+        std::vector<result_type> res;
+        res.reserve(shards);
+        for (auto& r : results) {
+            res.push_back(std::move(*r));
+        }
+        return res;
+    }
+}
+
+
 template<typename T>
 requires concepts::Task<std::decay_t<T>>
-asyncio::Task<bool> wait_for(T&& task, std::chrono::milliseconds timeout) {
+asyncio::Task<bool> wait_for(T&& task, std::chrono::nanoseconds timeout) {
     if (task.done()) {
         co_return false;
     }
     Event<bool> ev;
-    auto& loop = EventLoop::get();
-    auto timer = loop.call_later(timeout, [&ev, &task] {
-        task.cancel();
-        if (!ev.is_set()) {
-            ev.set(true);
+    struct Timeout final: TimerNode {
+        Event<bool>& ev;
+        T& task;
+
+        Timeout(Event<bool>& ev, T& task) noexcept: ev(ev), task(task) {}
+
+        void expire() noexcept override {
+            task.cancel();
+            if (!ev.is_set()) {
+                ev.set(true);
+            }
         }
-    });
+    } timer { ev, task };
+    EventLoop::get().call_later(timeout, timer);
     if constexpr (std::is_void_v<typename std::decay_t<T>::result_type>) {
-        task.add_done_callback([timer, &ev] {
-            timer->cancel();
+        task.add_done_callback([&timer, &ev] {
+            timer.unschedule();
             if (!ev.is_set()) {
                 ev.set(false);
             }
         });
     } else {
-        task.add_done_callback([timer, &ev](const auto& _) {
-            timer->cancel();
+        task.add_done_callback([&timer, &ev](const auto& _) {
+            timer.unschedule();
             if (!ev.is_set()) {
                 ev.set(false);
             }
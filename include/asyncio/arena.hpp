@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+
+#include "asyncio_ns.hpp"
+#include "asyncio_export.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+template<typename T>
+class ArenaAllocator;
+
+/// bump pointer arena, memory is only given back all at once by `reset` or
+/// the destructor. meant to hold the coroutine frames of one request, so it
+/// must outlive them and stay on the thread of the request
+class ASYNCIO_EXPORT Arena {
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+    Chunk* _chunks { nullptr };
+    std::byte* _cur { nullptr };
+    std::byte* _end { nullptr };
+    size_t _chunk_size;
+    size_t _used { 0 };
+
+    void _grow(size_t size);
+public:
+    explicit Arena(size_t chunk_size = 4096) noexcept;
+    Arena(Arena&) = delete;
+    Arena(Arena&&) = delete;
+    Arena& operator=(Arena&) = delete;
+    Arena& operator=(Arena&&) = delete;
+    ~Arena() noexcept;
+
+    [[nodiscard]] void* allocate(size_t size, size_t align);
+    /// release everything, the newest chunk is kept for the next request
+    void reset() noexcept;
+    /// bytes handed out since the last reset
+    [[nodiscard]] inline size_t used() const noexcept { return _used; }
+
+    template<typename T = std::byte>
+    [[nodiscard]] inline ArenaAllocator<T> allocator() noexcept { return ArenaAllocator<T>(*this); }
+};
+
+
+/// standard allocator over an Arena, deallocation is a no-op
+template<typename T>
+class ArenaAllocator {
+private:
+    Arena* _arena;
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) noexcept: _arena(&arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& alloc) noexcept: _arena(alloc.arena()) {}
+
+    [[nodiscard]] inline T* allocate(size_t n) {
+        return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    inline void deallocate(T*, size_t) noexcept {}
+    inline Arena* arena() const noexcept { return _arena; }
+
+    template<typename U>
+    inline bool operator==(const ArenaAllocator<U>& alloc) const noexcept {
+        return _arena == alloc.arena();
+    }
+};
+
+ASYNCIO_NS_END
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "asyncio_ns.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// move-only `void()` callable stored inline, it never allocates.
+/// a callable larger than `Capacity` is rejected at compile time
+template<size_t Capacity>
+class InplaceCallback {
+private:
+    struct VTable {
+        void (*call)(void*) noexcept;
+        // nullptr when the callable can be relocated with memcpy
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template<typename F>
+    static constexpr VTable _vtable {
+        [](void* p) noexcept { (*static_cast<F*>(p))(); },
+        std::is_trivially_copyable_v<F>
+            ? nullptr
+            : +[](void* dst, void* src) noexcept {
+                new (dst) F(std::move(*static_cast<F*>(src)));
+                static_cast<F*>(src)->~F();
+            },
+        [](void* p) noexcept { static_cast<F*>(p)->~F(); },
+    };
+
+    alignas(std::max_align_t) std::byte _storage[Capacity];
+    const VTable* _vt { nullptr };
+
+    void _move_from(InplaceCallback& cb) noexcept {
+        if ((_vt = std::exchange(cb._vt, nullptr))) {
+            if (_vt->move) {
+                _vt->move(_storage, cb._storage);
+            } else {
+                std::memcpy(_storage, cb._storage, Capacity);
+            }
+        }
+    }
+
+    void _reset() noexcept {
+        if (auto vt = std::exchange(_vt, nullptr)) {
+            vt->destroy(_storage);
+        }
+    }
+public:
+    static constexpr size_t capacity = Capacity;
+
+    InplaceCallback() noexcept = default;
+    InplaceCallback(std::nullptr_t) noexcept {}
+    InplaceCallback(InplaceCallback&) = delete;
+    InplaceCallback& operator=(InplaceCallback&) = delete;
+
+    template<typename F>
+    requires (!std::same_as<std::decay_t<F>, InplaceCallback>) && std::invocable<std::decay_t<F>&>
+    InplaceCallback(F&& f) noexcept {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Capacity, "callback capture exceeds the inline capacity, raise ASYNCIO_CALLBACK_CAPACITY");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callback is over aligned");
+        static_assert(std::is_nothrow_move_constructible_v<Fn>, "callback must be nothrow move constructible");
+        new (_storage) Fn(std::forward<F>(f));
+        _vt = &_vtable<Fn>;
+    }
+
+    InplaceCallback(InplaceCallback&& cb) noexcept {
+        _move_from(cb);
+    }
+
+    InplaceCallback& operator=(InplaceCallback&& cb) noexcept {
+        if (this != &cb) {
+            _reset();
+            _move_from(cb);
+        }
+        return *this;
+    }
+
+    InplaceCallback& operator=(std::nullptr_t) noexcept {
+        _reset();
+        return *this;
+    }
+
+    ~InplaceCallback() noexcept {
+        _reset();
+    }
+
+    inline void operator()() noexcept {
+        _vt->call(_storage);
+    }
+
+    inline explicit operator bool() const noexcept {
+        return _vt != nullptr;
+    }
+};
+
+ASYNCIO_NS_END
@@ -22,20 +22,28 @@ concept Awaitable = requires(A awaiter) {
         { awaiter.await_suspend(handle) } -> std::same_as<void>;
     } || requires(std::coroutine_handle<> handle) {
         { awaiter.await_suspend(handle) } -> std::same_as<bool>;
+    } || requires(std::coroutine_handle<> handle) {
+        { awaiter.await_suspend(handle) } -> std::convertible_to<std::coroutine_handle<>>;
     };
 };
 
 
+/// return object of a coroutine driven by the event loop
 template<typename T>
-concept Task = Cancelable<T> && requires(T task) {
-    typename T::Callback;
+concept Coroutine = requires(T coro) {
     typename T::result_type;
     typename T::promise_type;
     requires std::move_constructible<T>;
     requires !std::default_initializable<T>;
     requires !std::copy_constructible<T>;
-    { task.done() } -> std::same_as<bool>;
-    { task.valid() } -> std::same_as<bool>;
+    { coro.done() } -> std::same_as<bool>;
+    { coro.valid() } -> std::same_as<bool>;
+};
+
+
+template<typename T>
+concept Task = Coroutine<T> && Cancelable<T> && requires(T task) {
+    typename T::Callback;
     requires
         requires { { task.result() } -> std::same_as<typename T::result_type>; } ||
         requires { { task.result() } -> std::same_as<typename T::result_type&>; };
@@ -47,7 +55,7 @@ concept Task = Cancelable<T> && requires(T task) {
 
 template<typename P>
 concept Promise = requires(P promise) {
-    { promise.get_return_object() } -> Task;
+    { promise.get_return_object() } -> Coroutine;
     { promise.initial_suspend() } -> Awaitable;
     { promise.final_suspend() } noexcept -> Awaitable;
     { promise.unhandled_exception() } -> std::same_as<void>;
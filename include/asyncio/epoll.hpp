@@ -1,6 +1,7 @@
 #pragma once
+#include <chrono>
 #include <optional>
-#include <unordered_map>
+#include <vector>
 #include <sys/epoll.h>
 
 #include "handle.hpp"
@@ -15,12 +16,20 @@ using namespace types;
 class ASYNCIO_EXPORT Epoll {
 public:
     struct Event;
+    struct Callbacks;
 private:
     int _fd { -1 };
-    std::unordered_map<int, Event> _map;
+    // fallback for kernels without epoll_pwait2
+    int _timerfd { -1 };
+    /// both indexed by fd, the callbacks are only touched to wait or wake
+    std::vector<Event> _events;
+    std::vector<Callbacks> _callbacks;
 
     Epoll() noexcept = default;
     int fd() noexcept;
+    Event& _register(int fd) noexcept;
+    [[nodiscard]] Event* _find(int fd) noexcept;
+    [[nodiscard]] int _wait_timerfd(epoll_event* events, int event_num, std::chrono::nanoseconds timeout) noexcept;
 public:
     [[nodiscard]] static Epoll& get() noexcept;
     Epoll(Epoll&) = delete;
@@ -33,17 +42,40 @@ public:
     void add_writer(int, Handle::ID, EventLoopCallback&&) noexcept;
     void remove_reader(int) noexcept;
     void remove_writer(int) noexcept;
+    /// drop the callback of fd if it still belongs to `id`, for awaiters
+    /// destroyed while waiting. fd may have been cleared already
+    void cancel_reader(int fd, Handle::ID id) noexcept;
+    void cancel_writer(int fd, Handle::ID id) noexcept;
     void clear_fd(int) noexcept;
+    [[nodiscard]] uint32_t ready(int) const noexcept;
+    void clear_ready(int, uint32_t) noexcept;
+    /// fd an epoll event refers to, -1 if the fd was cleared since
+    [[nodiscard]] int from(const epoll_event&) const noexcept;
+    /// record readiness reported by epoll for a registered fd
+    void mark_ready(int fd, uint32_t events) noexcept;
+    /// callbacks of a registered fd
+    [[nodiscard]] Callbacks& callbacks(int fd) noexcept;
 
-    [[nodiscard]] inline int wait(epoll_event* events, int event_num, int timeout) noexcept {
-        return epoll_wait(_fd, events, event_num, timeout);
-    }
+    [[nodiscard]] int wait(epoll_event* events, int event_num, std::chrono::nanoseconds timeout) noexcept;
 };
 
+/// every fd is registered once, edge-triggered for both directions, until
+/// `clear_fd`. `ready` caches the readiness reported by epoll, awaiters skip
+/// the syscall while a bit is clear and clear it again on EAGAIN.
+/// the `data.u64` of the epoll event carries fd and generation. entries are
+/// small so the readiness checks of neighbouring fds share cache lines
 struct Epoll::Event {
+    static constexpr uint32_t EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    uint32_t generation { 0 };
+    uint32_t ready { EPOLLIN | EPOLLOUT };
+    bool registered { false };
+};
+static_assert(sizeof(Epoll::Event) == 12);
+
+/// one-shot callbacks waiting for readiness of an fd
+struct Epoll::Callbacks {
     std::optional<EventLoopHandle> reader { std::nullopt };
     std::optional<EventLoopHandle> writer { std::nullopt };
-    epoll_event event {};
 };
 
 ASYNCIO_NS_END
@@ -1,12 +1,16 @@
 #pragma once
-#include <queue>
 #include <chrono>
-#include <mutex>
+#include <atomic>
+#include <functional>
+#include <sys/epoll.h>
 
 #include "handle.hpp"
 #include "concepts.hpp"
 #include "types.hpp"
 #include "timer.hpp"
+#include "timer_queue.hpp"
+#include "mpsc_queue.hpp"
+#include "ring_buffer.hpp"
 #include "asyncio_ns.hpp"
 #include "asyncio_export.hpp"
 
@@ -18,8 +22,59 @@ using namespace types;
 template<typename T>
 class FutureAwaiter;
 
+/// work deferred to the end of the iteration, the loop flushes every queued
+/// node once right before it polls, so what was issued while running the
+/// ready queue goes out together
+class ASYNCIO_EXPORT FlushNode {
+    friend EventLoop;
+public:
+    FlushNode() noexcept = default;
+    FlushNode(FlushNode&) = delete;
+    FlushNode(FlushNode&&) = delete;
+    FlushNode& operator=(FlushNode&) = delete;
+    FlushNode& operator=(FlushNode&&) = delete;
+    virtual ~FlushNode() noexcept;
+
+    inline bool queued() const noexcept { return _queued; }
+protected:
+    virtual void flush() noexcept = 0;
+private:
+    bool _queued { false };
+};
+
 class ASYNCIO_EXPORT EventLoop {
+    friend Timer;
+    friend FlushNode;
 public:
+    /// runtime counters of the loop, kept since it was created.
+    /// peaks are reset after every periodic snapshot
+    struct Stats {
+        uint64_t iterations { 0 };
+        /// coroutines resumed and callbacks run from the ready queue
+        uint64_t callbacks { 0 };
+        /// peak size of the ready queue at the start of a run
+        size_t ready_high_water { 0 };
+        /// epoll waits and the events they returned
+        uint64_t polls { 0 };
+        uint64_t events { 0 };
+        size_t max_events { 0 };
+        /// time spent waiting for events and running what became ready
+        std::chrono::nanoseconds blocked { 0 };
+        std::chrono::nanoseconds running { 0 };
+        uint64_t timers_scheduled { 0 };
+        uint64_t timers_fired { 0 };
+        /// timers dropped from the schedule before their deadline
+        uint64_t timers_canceled { 0 };
+        /// passes purging canceled timers from the schedule
+        uint64_t timer_compactions { 0 };
+        /// delay between the deadline of a timer and its firing
+        std::chrono::nanoseconds lag_total { 0 };
+        std::chrono::nanoseconds lag_max { 0 };
+        /// runs over the slow callback threshold
+        uint64_t slow_callbacks { 0 };
+    };
+    using StatsCallback = std::function<void(const Stats&)>;
+
     [[nodiscard]] static EventLoop& get() noexcept;
     EventLoop(EventLoop&) = delete;
     EventLoop(EventLoop&&) = delete;
@@ -27,12 +82,30 @@ public:
     EventLoop& operator=(EventLoop&&) = delete;
     void call_soon(EventLoopCallback&& callback) noexcept;
     void call_soon(Handle& handle) noexcept;
+    void call_soon(CoroHandle& handle) noexcept;
     void call_soon_threadsafe(EventLoopCallback&& callback) noexcept;
     void call_soon_threadsafe(Handle& handle) noexcept;
     std::shared_ptr<Timer> call_at(TimePoint when, EventLoopCallback&& callback) noexcept;
-    std::shared_ptr<Timer> call_later(std::chrono::milliseconds delay, EventLoopCallback&& callback) noexcept;
+    std::shared_ptr<Timer> call_later(std::chrono::nanoseconds delay, EventLoopCallback&& callback) noexcept;
+    void call_at(TimePoint when, TimerNode& node) noexcept;
+    void call_later(std::chrono::nanoseconds delay, TimerNode& node) noexcept;
+    /// flush `node` before the next poll, queuing it twice is a no-op
+    void call_before_poll(FlushNode& node) noexcept;
     void stop() noexcept;
     void run() noexcept;
+    /// spin for at most `budget` before parking in epoll_wait, the spin
+    /// adapts to the idle gaps between events, zero turns it off
+    void set_busy_poll(std::chrono::microseconds budget) noexcept;
+    /// run at most `limit` ready entries per iteration, the rest waits for
+    /// the next one so that timers and io are not starved, zero is no limit
+    void set_max_callbacks(size_t limit) noexcept;
+    [[nodiscard]] Stats stats() const noexcept;
+    /// call `callback` with a snapshot of the stats every `interval`
+    /// while the loop runs, a null callback turns it off
+    void set_stats_callback(std::chrono::nanoseconds interval, StatsCallback&& callback) noexcept;
+    /// time every callback and resume, the ones over `threshold` are logged
+    /// with the location and traceback of their task, zero turns it off
+    void set_slow_callback_duration(std::chrono::nanoseconds threshold) noexcept;
 
     inline bool is_root(Handle::ID id) const noexcept { return _root_id == id; }
 
@@ -47,9 +120,8 @@ public:
     template<typename Pool, typename F, typename... Args>
     [[nodiscard]] inline auto run_in_thread(Pool& pool, F&& f, Args&&... args) noexcept {
         using result_type = decltype(std::forward<F>(f)(std::forward<Args>(args)...));
-        _init_thread_eventfd();
         return std::make_shared<FutureAwaiter<result_type>>(
-            _eventfd,
+            *this,
             pool,
             std::forward<F>(f),
             std::forward<Args>(args)...
@@ -57,16 +129,62 @@ public:
     }
 private:
     bool _stop { false };
-    std::mutex _mtx {};
+    // true only while parked in epoll_wait, producers write eventfd when they
+    // are the first to observe it
+    std::atomic<bool> _sleeping { false };
     int _eventfd { -1 };
+    uint64_t _interrupt_seen { 0 };
+    std::chrono::nanoseconds _busy_poll { 0 };
+    // moving average of the time spent waiting for events
+    std::chrono::nanoseconds _idle_gap { 0 };
+    std::chrono::nanoseconds _slow_callback { 0 };
+    size_t _max_callbacks { 0 };
+    // sized between MIN_EVENTS_NUM and MAX_EVENTS_NUM by the recent batches
+    std::vector<epoll_event> _events {};
+    // consecutive polls that used under a quarter of `_events`
+    uint32_t _events_idle { 0 };
     Handle::ID _root_id { 0 };
-    std::vector<std::shared_ptr<Timer>> _schedule {};
-    std::queue<EventLoopHandle> _ready {};
+    std::unique_ptr<TimerQueue> _schedule;
+    std::vector<TimerNode*> _expired {};
+    // null entries are nodes destroyed while queued
+    std::vector<FlushNode*> _flushes {};
+    /// entry of the ready queue, a coroutine resumed directly or,
+    /// when `handle` is null, the next entry of `_callbacks`
+    struct ReadyItem {
+        CoroHandle* handle { nullptr };
+        Handle::ID id { 0 };
+    };
+    RingBuffer<ReadyItem> _ready {};
+    RingBuffer<EventLoopHandle> _callbacks {};
+    MPSCQueue<EventLoopHandle> _inbox {};
+    Stats _stats {};
+    /// fires the stats callback, embedded so that it never allocates
+    struct StatsTimer final: TimerNode {
+        std::chrono::nanoseconds interval { 0 };
+        StatsCallback callback { nullptr };
+
+        void expire() noexcept override;
+    };
+    StatsTimer _stats_timer {};
 
     EventLoop() noexcept;
     void _init_thread_eventfd() noexcept;
-    void _process_epoll(int timeout) noexcept;
+    void _watch_eventfd() noexcept;
+#if ASYNCIO_IO_URING
+    void _watch_io_uring() noexcept;
+#endif
+    void _init_interrupt() noexcept;
+    void _watch_interrupt() noexcept;
+    void _wakeup() noexcept;
+    void _call_soon(Handle::ID id, EventLoopCallback&& callback) noexcept;
+    int _poll(std::chrono::nanoseconds timeout) noexcept;
+    int _park(std::chrono::nanoseconds timeout) noexcept;
+    void _resize_events(int num) noexcept;
+    void _cancel_flush(FlushNode& node) noexcept;
+    void _run_flushes() noexcept;
+    void _process_epoll(std::chrono::nanoseconds timeout) noexcept;
     void _run_once() noexcept;
+    void _run_ready_timed(size_t size) noexcept;
     void _cleanup() noexcept;
     static inline TimePoint _time() noexcept {
         return Clock::now();
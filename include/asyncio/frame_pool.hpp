@@ -0,0 +1,182 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#include "types.hpp"
+#include "asyncio_ns.hpp"
+#include "asyncio_export.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// per-thread free lists of coroutine frames, one per size class of
+/// GRANULARITY bytes. blocks come one by one from the global allocator, so a
+/// frame freed on another thread simply joins that thread's pool. frames
+/// larger than FRAME_POOL_MAX_SIZE bypass the pool
+class ASYNCIO_EXPORT FramePool {
+public:
+    static constexpr size_t GRANULARITY = 64;
+    static constexpr size_t CLASSES = (FRAME_POOL_MAX_SIZE + GRANULARITY - 1) / GRANULARITY;
+    struct Stats {
+        /// allocations served from a free list
+        uint64_t hits { 0 };
+        /// allocations that went to the global allocator
+        uint64_t misses { 0 };
+        /// blocks currently kept in the free lists
+        size_t cached { 0 };
+    };
+private:
+    struct Block {
+        Block* next;
+    };
+    struct FreeList {
+        Block* head { nullptr };
+        size_t size { 0 };
+    };
+    std::array<FreeList, CLASSES> _lists {};
+    Stats _stats {};
+
+    FramePool() noexcept = default;
+    [[nodiscard]] static inline size_t _class_of(size_t size) noexcept {
+        return (size - 1) / GRANULARITY;
+    }
+    [[nodiscard]] static inline size_t _block_size(size_t size) noexcept {
+        return size <= FRAME_POOL_MAX_SIZE ? (_class_of(size) + 1) * GRANULARITY : size;
+    }
+    /// slow paths through the global allocator, kept out of line
+    [[nodiscard]] void* _allocate(size_t size);
+    static void _deallocate(void* ptr, size_t size) noexcept;
+public:
+    [[nodiscard]] static FramePool& get() noexcept;
+    FramePool(FramePool&) = delete;
+    FramePool(FramePool&&) = delete;
+    FramePool& operator=(FramePool&) = delete;
+    FramePool& operator=(FramePool&&) = delete;
+    ~FramePool() noexcept;
+
+    [[nodiscard]] inline void* allocate(size_t size) {
+        if (size <= FRAME_POOL_MAX_SIZE) [[likely]] {
+            auto& list = _lists[_class_of(size)];
+            if (auto block = list.head) [[likely]] {
+                list.head = block->next;
+                list.size--;
+                _stats.hits++;
+                return block;
+            }
+        }
+        return _allocate(size);
+    }
+
+    inline void deallocate(void* ptr, size_t size) noexcept {
+        if (size <= FRAME_POOL_MAX_SIZE) [[likely]] {
+            auto& list = _lists[_class_of(size)];
+            if (list.size < FRAME_POOL_CACHE) [[likely]] {
+                list.head = new (ptr) Block { list.head };
+                list.size++;
+                return;
+            }
+        }
+        _deallocate(ptr, size);
+    }
+
+    /// fill the size class of `size` bytes frames with `count` blocks,
+    /// so that the first requests do not reach the global allocator
+    void prewarm(size_t size, size_t count) noexcept;
+    [[nodiscard]] Stats stats() const noexcept;
+    /// give every cached block back to the global allocator
+    void clear() noexcept;
+};
+
+
+/// allocates Task frames, from the frame pool or, for coroutines taking
+/// `std::allocator_arg_t, Alloc` as leading parameters, from `Alloc`.
+/// every frame is followed by the deleter that releases it, null for pooled
+/// frames, and by a copy of the allocator if any
+class FrameAllocator {
+private:
+    using Deleter = void (*)(void* frame, size_t size) noexcept;
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Block {
+        std::byte data[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+    };
+
+    static constexpr size_t _align_up(size_t size, size_t align) noexcept {
+        return (size + align - 1) & ~(align - 1);
+    }
+    static constexpr size_t _deleter_offset(size_t size) noexcept {
+        return _align_up(size, alignof(Deleter));
+    }
+    template<typename Alloc>
+    static constexpr size_t _alloc_offset(size_t size) noexcept {
+        return _align_up(_deleter_offset(size) + sizeof(Deleter), alignof(Alloc));
+    }
+    template<typename Alloc>
+    static constexpr size_t _blocks(size_t size) noexcept {
+        return (_alloc_offset<Alloc>(size) + sizeof(Alloc) + sizeof(Block) - 1) / sizeof(Block);
+    }
+    static inline Deleter& _deleter(void* frame, size_t size) noexcept {
+        return *reinterpret_cast<Deleter*>(static_cast<std::byte*>(frame) + _deleter_offset(size));
+    }
+
+    template<typename Alloc>
+    static void _delete(void* frame, size_t size) noexcept {
+        using Traits = std::allocator_traits<Alloc>::template rebind_traits<Block>;
+        auto stored = reinterpret_cast<Alloc*>(static_cast<std::byte*>(frame) + _alloc_offset<Alloc>(size));
+        typename Traits::allocator_type alloc(std::move(*stored));
+        stored->~Alloc();
+        Traits::deallocate(alloc, static_cast<Block*>(frame), _blocks<Alloc>(size));
+    }
+public:
+    [[nodiscard]] static inline void* allocate(size_t size) {
+        auto frame = FramePool::get().allocate(_deleter_offset(size) + sizeof(Deleter));
+        _deleter(frame, size) = nullptr;
+        return frame;
+    }
+
+    template<typename Alloc>
+    [[nodiscard]] static void* allocate(size_t size, const Alloc& alloc) {
+        using Traits = std::allocator_traits<Alloc>::template rebind_traits<Block>;
+        typename Traits::allocator_type block_alloc(alloc);
+        void* frame = Traits::allocate(block_alloc, _blocks<Alloc>(size));
+        _deleter(frame, size) = &_delete<Alloc>;
+        new (static_cast<std::byte*>(frame) + _alloc_offset<Alloc>(size)) Alloc(alloc);
+        return frame;
+    }
+
+    static inline void deallocate(void* frame, size_t size) noexcept {
+        if (auto deleter = _deleter(frame, size)) {
+            deleter(frame, size);
+        } else {
+            FramePool::get().deallocate(frame, _deleter_offset(size) + sizeof(Deleter));
+        }
+    }
+};
+
+
+/// base of promise types, their frames are recycled through the per-thread
+/// pool unless the coroutine takes `std::allocator_arg_t, Alloc` as leading
+/// parameters
+struct FrameAllocated {
+    static void* operator new(size_t size) {
+        return FrameAllocator::allocate(size);
+    }
+
+    template<typename Alloc, typename... Args>
+    static void* operator new(size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...) {
+        return FrameAllocator::allocate(size, alloc);
+    }
+
+    /// member coroutines receive the object first
+    template<typename This, typename Alloc, typename... Args>
+    static void* operator new(size_t size, const This&, std::allocator_arg_t, const Alloc& alloc, const Args&...) {
+        return FrameAllocator::allocate(size, alloc);
+    }
+
+    static void operator delete(void* ptr, size_t size) noexcept {
+        FrameAllocator::deallocate(ptr, size);
+    }
+};
+
+ASYNCIO_NS_END
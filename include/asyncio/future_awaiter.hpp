@@ -1,8 +1,6 @@
 #pragma once
 #include <cassert>
 #include <future>
-#include <fcntl.h>
-#include <sys/eventfd.h>
 
 #include "asyncio_ns.hpp"
 #include "concepts.hpp"
@@ -26,16 +24,17 @@ public:
     } && requires (F&& f, Args&&... args) {
         { std::forward<F>(f)(std::forward<Args>(args)...) } -> std::same_as<R>;
     }
-    FutureAwaiter(int eventfd, Pool& pool, F&& f, Args&&... args):
+    FutureAwaiter(EventLoop& loop, Pool& pool, F&& f, Args&&... args):
+        _loop(loop),
         _fut(
             pool.submit(
-                [this, eventfd, f = std::forward<F>(f), ...args = std::forward<Args>(args)] mutable -> R {
+                [this, f = std::forward<F>(f), ...args = std::forward<Args>(args)] mutable -> R {
                     if constexpr (std::is_void_v<R>) {
                         std::forward<F>(f)(std::forward<Args>(args)...);
-                        _done_callback(eventfd);
+                        _done_callback();
                     } else {
                         R res = std::forward<F>(f)(std::forward<Args>(args)...);
-                        _done_callback(eventfd);
+                        _done_callback();
                         return res;
                     }
                 }
@@ -68,16 +67,17 @@ public:
         }
     }
 private:
+    // done callback runs in a pool thread, so the owning loop is captured here
+    EventLoop& _loop;
     std::future<R> _fut { nullptr };
     std::atomic<uint64_t> _status { 0 };
 
-    void _done_callback(int eventfd) noexcept {
+    void _done_callback() noexcept {
         uint64_t status;
         do {
             status = _status.load();
             if (status != 0) {
-                EventLoop::get().call_soon_threadsafe(*(Handle*)status);
-                eventfd_write(eventfd, 1);
+                _loop.call_soon_threadsafe(*(Handle*)status);
                 return;
             }
         } while (!_status.compare_exchange_weak(status, 1));
@@ -1,6 +1,7 @@
 #pragma once
-#include <unordered_set>
+#include <vector>
 #include <source_location>
+#include <coroutine>
 #include <cstdint>
 
 #include "types.hpp"
@@ -13,13 +14,21 @@ ASYNCIO_NS_BEGIN()
 using namespace types;
 
 class EventLoop;
+class CompletionCounter;
 struct EventLoopHandle;
+/// handles live in a per-thread slot table, an ID packs the slot index in
+/// the low 32 bits and the slot generation in the high 32 bits. canceling
+/// or destroying a handle bumps the generation, so every ID issued before
+/// becomes stale and slots can be reused without ever aliasing. ID 0 is
+/// the reserved slot 0 and never turns stale.
 class ASYNCIO_EXPORT Handle {
     friend EventLoop;
 public:
-    using ID = uint32_t;
+    using ID = uint64_t;
     static ID new_id() noexcept;
-    static bool canceled(ID id) noexcept;
+    [[nodiscard]] static inline bool canceled(ID id) noexcept {
+        return _generations[(uint32_t)id] != (uint32_t)(id >> 32);
+    }
     Handle(Handle&) = delete;
     Handle& operator=(Handle&) = delete;
     Handle() noexcept;
@@ -31,7 +40,9 @@ public:
     inline ID id() const noexcept { return _id; }
     inline bool canceled() const noexcept { return _canceled; }
 private:
-    static std::unordered_set<ID> _canceled_handles;
+    static thread_local std::vector<uint32_t> _generations;
+    static thread_local std::vector<uint32_t> _free_slots;
+    static void _release(ID id, bool canceled) noexcept;
     ID _id { 0 };
     bool _canceled { true };
 };
@@ -43,8 +54,71 @@ public:
     void try_resume_parent() const noexcept;
     void traceback(int depth) const noexcept;
     virtual const std::source_location& get_loc() const noexcept = 0;
+    /// resumed directly by the event loop, without going through `run`
+    inline std::coroutine_handle<> coroutine() const noexcept { return _coro; }
+    /// a canceled coroutine never finishes, it reports to its counter here
+    void cancel() noexcept override;
+    /// report completion to `counter` in place of a done callback
+    inline void set_counter(CompletionCounter* counter) noexcept { _counter = counter; }
+    inline CompletionCounter* counter() const noexcept { return _counter; }
+    /// finished with an unhandled exception or an unexpected result
+    inline bool failed() const noexcept { return _failed; }
+protected:
+    std::coroutine_handle<> _coro { nullptr };
+
+    [[nodiscard]] CoroHandle* parent_to_resume() const noexcept;
+    /// called by the promise once its coroutine finished
+    void report_completion(bool failed) noexcept;
 private:
     CoroHandle* _parent { nullptr };
+    CompletionCounter* _counter { nullptr };
+    bool _failed { false };
+};
+
+
+/// fan-in point of a set of tasks. every task finishing or canceled counts
+/// it down in place of a done callback, the waiter is queued once all are
+/// done, at the first one or at the first failure according to `Wake`.
+/// a running task reports to one counter at a time
+class ASYNCIO_EXPORT CompletionCounter {
+public:
+    enum class Wake: uint8_t { All, First, Error };
+    /// runs once, as the first failure is recorded
+    using FailureHook = InplaceCallback<sizeof(void*)>;
+
+    explicit CompletionCounter(Wake wake = Wake::All, FailureHook&& on_failure = nullptr) noexcept:
+        _wake(wake), _on_failure(std::move(on_failure)) {}
+    CompletionCounter(CompletionCounter&) = delete;
+    CompletionCounter(CompletionCounter&&) = delete;
+    CompletionCounter& operator=(CompletionCounter&) = delete;
+    CompletionCounter& operator=(CompletionCounter&&) = delete;
+
+    /// count `child` in, it reports back through `complete`. a child
+    /// already reporting to another counter is rejected
+    void add(CoroHandle& child) noexcept;
+    void complete(const CoroHandle& child, bool failed) noexcept;
+    /// stop listening to `child` if it has not reported yet
+    void remove(CoroHandle& child) noexcept;
+
+    /// whether the waiter may go on without suspending
+    [[nodiscard]] inline bool ready() const noexcept {
+        return _pending == 0
+            || (_wake == Wake::First && _first)
+            || (_wake == Wake::Error && _failed);
+    }
+    inline void wait(CoroHandle& waiter) noexcept { _waiter = &waiter; }
+    inline size_t pending() const noexcept { return _pending; }
+    /// first child to report, 0 if none did
+    inline Handle::ID first() const noexcept { return _first; }
+    /// first child to fail, 0 if none did
+    inline Handle::ID failed() const noexcept { return _failed; }
+private:
+    size_t _pending { 0 };
+    Wake _wake;
+    CoroHandle* _waiter { nullptr };
+    Handle::ID _first { 0 };
+    Handle::ID _failed { 0 };
+    FailureHook _on_failure;
 };
 
 
@@ -0,0 +1,119 @@
+#pragma once
+#include "asyncio_config.hpp"
+#if ASYNCIO_IO_URING
+#include <span>
+#include <vector>
+#include <unordered_map>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+#include "handle.hpp"
+#include "ring_buffer.hpp"
+#include "asyncio_ns.hpp"
+#include "asyncio_export.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+using namespace types;
+
+/// completion based socket io on io_uring through raw syscalls, one per thread.
+/// submissions are queued and flushed once per loop iteration, completions
+/// are reaped from the shared ring without a syscall and resume the awaiting
+/// coroutine directly
+class ASYNCIO_EXPORT IoUring {
+public:
+    using OpID = uint32_t;
+    static constexpr OpID NO_OP = -1;
+    /// told about the completion of an op in place of queuing its handle,
+    /// lets an awaiter resubmit the rest of a short op without resuming
+    class Completion {
+    public:
+        virtual void complete(OpID op) noexcept = 0;
+    };
+private:
+    enum class Kind: uint8_t { Single, Accept, Orphan };
+    /// in-flight operation, the `user_data` of its sqe is the op index
+    struct Op {
+        Handle::ID id { 0 };
+        CoroHandle* handle { nullptr };
+        Completion* completion { nullptr };
+        int res { 0 };
+        int fd { -1 };
+        Kind kind { Kind::Single };
+        bool pending { false };
+    };
+    /// multishot accept armed on a listening fd
+    struct Acceptor {
+        OpID op { NO_OP };
+        int error { 0 };
+        Handle::ID id { 0 };
+        CoroHandle* waiter { nullptr };
+        RingBuffer<int> conns {};
+    };
+
+    int _fd { -1 };
+    void* _ring { nullptr };
+    size_t _ring_size { 0 };
+    io_uring_sqe* _sqes { nullptr };
+    uint32_t* _sq_head { nullptr };
+    uint32_t* _sq_tail { nullptr };
+    uint32_t _sq_mask { 0 };
+    uint32_t _sq_entries { 0 };
+    uint32_t _to_submit { 0 };
+    uint32_t* _cq_head { nullptr };
+    uint32_t* _cq_tail { nullptr };
+    uint32_t _cq_mask { 0 };
+    io_uring_cqe* _cqes { nullptr };
+    std::vector<Op> _ops {};
+    std::vector<OpID> _free_ops {};
+    std::unordered_map<int, Acceptor> _acceptors {};
+    char* _buffers { nullptr };
+    std::vector<uint16_t> _free_buffers {};
+
+    IoUring() noexcept;
+    void _register_buffers() noexcept;
+    [[nodiscard]] io_uring_sqe* _get_sqe() noexcept;
+    [[nodiscard]] OpID _new_op(CoroHandle* handle, Kind kind, Completion* completion = nullptr) noexcept;
+    [[nodiscard]] int _buffer_index(const void* buffer, size_t size) const noexcept;
+    void _arm_accept(int fd, Acceptor& acceptor) noexcept;
+    void _complete(uint64_t user_data, int res, uint32_t flags) noexcept;
+    void _cancel(OpID op) noexcept;
+public:
+    [[nodiscard]] static IoUring& get() noexcept;
+    IoUring(IoUring&) = delete;
+    IoUring(IoUring&&) = delete;
+    IoUring& operator=(IoUring&) = delete;
+    IoUring& operator=(IoUring&&) = delete;
+    ~IoUring() noexcept;
+
+    inline int fd() const noexcept { return _fd; }
+    void submit() noexcept;
+    void reap() noexcept;
+    [[nodiscard]] bool has_completions() const noexcept;
+
+    [[nodiscard]] OpID recv(int fd, char* buffer, size_t size, CoroHandle& handle) noexcept;
+    [[nodiscard]] OpID send(int fd, const char* buffer, size_t size, CoroHandle& handle, Completion* completion = nullptr) noexcept;
+    /// `msg` and its iovecs must stay valid until the op completes or is dropped
+    [[nodiscard]] OpID sendmsg(int fd, const msghdr* msg, CoroHandle& handle, Completion* completion = nullptr) noexcept;
+    [[nodiscard]] OpID connect(int fd, const sockaddr* addr, socklen_t len, CoroHandle& handle) noexcept;
+    /// result of a finished op, the op is released
+    [[nodiscard]] int result(OpID op) noexcept;
+    /// give up an op, one still in flight is canceled and waited for, so
+    /// its buffer may be freed as soon as this returns
+    void drop(OpID op) noexcept;
+
+    /// pop an accepted connection of a listening fd, -1 with errno set when none
+    [[nodiscard]] int accepted(int fd) noexcept;
+    void wait_accept(int fd, CoroHandle& handle) noexcept;
+    void cancel_accept(int fd, CoroHandle& handle) noexcept;
+    /// cancel the multishot accept of fd and close queued connections
+    void clear_fd(int fd) noexcept;
+
+    /// registered buffer, reads into it use the fixed buffer op
+    [[nodiscard]] std::span<char> acquire_buffer() noexcept;
+    void release_buffer(std::span<char> buffer) noexcept;
+};
+
+ASYNCIO_NS_END
+#endif
@@ -0,0 +1,197 @@
+#pragma once
+#include <coroutine>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+#include "asyncio_ns.hpp"
+#include "event_loop.hpp"
+#include "concepts.hpp"
+#include "handle.hpp"
+#include "frame_pool.hpp"
+#include "task.hpp"
+#include "utils.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+using namespace types;
+
+/// task whose body only starts once it is awaited. the awaiting coroutine
+/// transfers to it directly and it transfers back on completion, so a call
+/// never goes through the ready queue and the frame does not outlive the
+/// awaiting expression, which lets the compiler elide it.
+/// use `Task` to spawn work that runs on its own
+template<typename R = void, typename E = void>
+class LazyTask {
+private:
+    struct Promise; friend Promise;
+    using CorounineHandle = std::coroutine_handle<Promise>;
+
+    CorounineHandle _handle { nullptr };
+
+    LazyTask(Promise& p): _handle(CorounineHandle::from_promise(p)) {}
+
+    inline void _check_valid() const noexcept {
+        if (!valid()) utils::abort("Invalid LazyTask");
+    }
+
+    template<bool Move>
+    struct Awaiter {
+        CorounineHandle handle;
+
+        bool await_ready(std::source_location loc = std::source_location::current()) const noexcept {
+            handle.promise().loc = loc;
+            return handle.done();
+        }
+
+        template<typename P>
+        requires concepts::Promise<P> || std::same_as<P, void>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) const noexcept {
+            handle.promise().set_parent(h.promise());
+            return handle;
+        }
+
+        decltype(auto) await_resume() const noexcept {
+            if constexpr (Move) {
+                return std::move(handle.promise()).get_result();
+            } else {
+                return handle.promise().get_result();
+            }
+        }
+    };
+public:
+    using result_type = TaskResult<R, E>;
+    using promise_type = Promise;
+
+    LazyTask() = delete;
+    LazyTask(LazyTask&) = delete;
+    LazyTask& operator=(LazyTask&) = delete;
+
+    LazyTask(LazyTask&& task) noexcept: _handle(std::exchange(task._handle, nullptr)) {}
+
+    LazyTask& operator=(LazyTask&& task) noexcept {
+        if (_handle) {
+            _handle.destroy();
+        }
+        _handle = std::exchange(task._handle, nullptr);
+        return *this;
+    }
+
+    /// nothing runs a lazy task but its awaiter, so the frame is always
+    /// destroyed with it, the awaiters suspended inside unlink themselves
+    ~LazyTask() {
+        if (auto h = std::exchange(_handle, nullptr)) {
+            h.destroy();
+        }
+    }
+
+    auto operator co_await() const & noexcept {
+        _check_valid();
+        return Awaiter<false> { _handle };
+    }
+
+    auto operator co_await() const && noexcept {
+        _check_valid();
+        return Awaiter<true> { _handle };
+    }
+
+    inline bool done() const noexcept {
+        _check_valid();
+        return _handle.done();
+    }
+
+    inline bool valid() const noexcept {
+        return _handle != nullptr;
+    }
+};
+
+
+template<typename R, typename E>
+struct LazyTask<R, E>::Promise final: public PromiseResult<R, E>, public CoroHandle, public FrameAllocated {
+    std::source_location loc {};
+    bool has_unhandled_exception { false };
+
+    Promise(std::source_location loc = std::source_location::current()): loc(loc) {
+        _coro = CorounineHandle::from_promise(*this);
+    }
+
+    inline void run() noexcept override {
+        CorounineHandle::from_promise(*this).resume();
+    }
+
+    inline const std::source_location& get_loc() const noexcept override {
+        return loc;
+    }
+
+    void check_result() noexcept {
+        if (canceled()) {
+            traceback(0);
+            utils::abort("Task Canceled");
+        }
+        if (!this->result_ready) {
+            traceback(0);
+            utils::abort("Task result not ready");
+        }
+    }
+
+    decltype(auto) get_result() & noexcept {
+        check_result();
+        if constexpr (!std::is_void_v<result_type>) {
+            return static_cast<result_type&>(this->result);
+        }
+    }
+
+    result_type get_result() && noexcept {
+        check_result();
+        if constexpr (!std::is_void_v<result_type>) {
+            return std::move(this->result);
+        }
+    }
+
+    //////////////////////////////////////
+    /// corounine related
+    //////////////////////////////////////
+    LazyTask<R, E> get_return_object() noexcept {
+        return { *this };
+    }
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    struct FinalAwaiter {
+        CoroHandle* const parent;
+        constexpr bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>) const noexcept {
+            if (parent) {
+                return parent->coroutine();
+            }
+            return std::noop_coroutine();
+        }
+        constexpr void await_resume() const noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept {
+        if (has_unhandled_exception) {
+            traceback(0);
+            EventLoop::get().stop();
+            return { nullptr };
+        }
+        return { parent_to_resume() };
+    }
+
+    constexpr void unhandled_exception() noexcept {
+        has_unhandled_exception = true;
+        try {
+            std::rethrow_exception(std::current_exception());
+        } catch (const std::exception& e) {
+            SPDLOG_ERROR("unhandled exception: {}", e.what());
+        }
+    }
+};
+
+static_assert(concepts::Coroutine<LazyTask<>>);
+static_assert(concepts::Promise<LazyTask<>::promise_type>);
+static_assert(concepts::Promise<LazyTask<int, int>::promise_type>);
+
+ASYNCIO_NS_END
@@ -21,8 +21,8 @@ public:
     Mutex& operator=(Mutex&) = delete;
     Mutex& operator=(Mutex&&) noexcept;
 private:
-    Handle* _owner { nullptr };
-    std::queue<Handle*> _wait_list {};
+    CoroHandle* _owner { nullptr };
+    std::queue<CoroHandle*> _wait_list {};
 };
 
 
@@ -54,7 +54,7 @@ public:
     }
 private:
     Mutex& _mtx;
-    Handle* _handle { nullptr };
+    CoroHandle* _handle { nullptr };
 };
 static_assert(concepts::Awaitable<Lock>, "Lock is not awaitable");
 
@@ -132,7 +132,7 @@ public:
 
     inline bool is_set() const noexcept { return _handle == nullptr; }
 private:
-    Handle* _handle { nullptr };
+    CoroHandle* _handle { nullptr };
 };
 
 
@@ -164,7 +164,7 @@ public:
     void notify_one() noexcept;
     void notify_all() noexcept;
 private:
-    std::queue<Handle*> _wait_list {};
+    std::queue<CoroHandle*> _wait_list {};
 };
 
 ASYNCIO_NS_END
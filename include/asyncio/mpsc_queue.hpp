@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+#include "asyncio_ns.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// lock-free multi-producer single-consumer queue.
+/// producers push onto an atomic stack, the consumer takes the whole stack
+/// at once and restores FIFO order, so there is no ABA problem
+template<typename T>
+class MPSCQueue {
+private:
+    struct Node {
+        Node* next;
+        T value;
+    };
+    std::atomic<Node*> _head { nullptr };
+public:
+    MPSCQueue() noexcept = default;
+    MPSCQueue(MPSCQueue&) = delete;
+    MPSCQueue(MPSCQueue&&) = delete;
+    MPSCQueue& operator=(MPSCQueue&) = delete;
+    MPSCQueue& operator=(MPSCQueue&&) = delete;
+
+    ~MPSCQueue() noexcept {
+        clear();
+    }
+
+    /// can be called from any thread
+    void push(T&& value) noexcept {
+        auto node = new Node { nullptr, std::move(value) };
+        auto head = _head.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!_head.compare_exchange_weak(head, node));
+    }
+
+    /// sequentially consistent, so it pairs with the sleeping flag of the loop
+    [[nodiscard]] inline bool empty() const noexcept {
+        return _head.load() == nullptr;
+    }
+
+    /// consumer only, pass every queued value to `f` in push order
+    template<typename F>
+    size_t consume(F&& f) noexcept {
+        auto node = _head.exchange(nullptr, std::memory_order_acquire);
+        Node* reversed = nullptr;
+        while (node) {
+            reversed = std::exchange(node->next, reversed);
+            std::swap(node, reversed);
+        }
+        size_t n = 0;
+        while (reversed) {
+            f(std::move(reversed->value));
+            delete std::exchange(reversed, reversed->next);
+            ++n;
+        }
+        return n;
+    }
+
+    void clear() noexcept {
+        consume([](T&&) {});
+    }
+};
+
+ASYNCIO_NS_END
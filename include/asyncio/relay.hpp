@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+#include "asyncio_ns.hpp"
+#include "asyncio_export.hpp"
+#include "socket.hpp"
+#include "task.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+struct RelayStats {
+    size_t a_to_b { 0 };
+    size_t b_to_a { 0 };
+    /// first error of either direction, nullptr when both ended cleanly
+    const char* error { nullptr };
+};
+
+/// move bytes between `a` and `b` in both directions until both ends closed.
+/// every direction splices through its own pipe, so the data never enters
+/// user space. the end of one direction shuts down the write side of its
+/// destination and the other one keeps going, an error shuts down both
+[[nodiscard]] ASYNCIO_EXPORT Task<RelayStats> relay(Socket& a, Socket& b) noexcept;
+
+ASYNCIO_NS_END
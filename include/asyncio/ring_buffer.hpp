@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+
+#include "asyncio_ns.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// FIFO queue over a power-of-two ring, grows by doubling and never shrinks,
+/// so a warmed up queue performs no allocation
+template<typename T>
+class RingBuffer {
+private:
+    std::unique_ptr<T[]> _buf { nullptr };
+    size_t _mask { 0 };
+    size_t _head { 0 };
+    size_t _tail { 0 };
+
+    void _grow() noexcept {
+        auto capacity = std::max<size_t>(16, (_mask + 1) * 2);
+        auto buf = std::make_unique<T[]>(capacity);
+        auto n = size();
+        for (size_t i = 0; i < n; ++i) {
+            buf[i] = std::move(_buf[(_head + i) & _mask]);
+        }
+        _buf = std::move(buf);
+        _mask = capacity - 1;
+        _head = 0;
+        _tail = n;
+    }
+public:
+    RingBuffer() noexcept = default;
+    RingBuffer(RingBuffer&) = delete;
+    RingBuffer& operator=(RingBuffer&) = delete;
+
+    [[nodiscard]] inline size_t size() const noexcept { return _tail - _head; }
+    [[nodiscard]] inline bool empty() const noexcept { return _tail == _head; }
+    [[nodiscard]] inline size_t capacity() const noexcept { return _buf ? _mask + 1 : 0; }
+
+    inline void push(T&& value) noexcept {
+        if (size() == capacity()) [[unlikely]] {
+            _grow();
+        }
+        _buf[_tail++ & _mask] = std::move(value);
+    }
+
+    [[nodiscard]] inline T& front() noexcept {
+        assert(!empty());
+        return _buf[_head & _mask];
+    }
+
+    /// remove and return the front element
+    [[nodiscard]] inline T take() noexcept {
+        assert(!empty());
+        return std::move(_buf[_head++ & _mask]);
+    }
+
+    inline void pop() noexcept {
+        assert(!empty());
+        _buf[_head++ & _mask] = T {};
+    }
+
+    void clear() noexcept {
+        while (!empty()) {
+            pop();
+        }
+        _head = _tail = 0;
+    }
+};
+
+ASYNCIO_NS_END
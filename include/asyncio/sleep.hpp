@@ -9,37 +9,51 @@
 
 ASYNCIO_NS_BEGIN()
 
-template<uint64_t MS>
-class sleep {
+/// sleep for a duration with the precision of the event loop clock
+class sleep_for {
 private:
-    std::shared_ptr<Timer> _timer { nullptr };
+    /// lives in the coroutine frame together with the awaiter
+    struct Node final: TimerNode {
+        CoroHandle* handle { nullptr };
+
+        void expire() noexcept override {
+            EventLoop::get().call_soon(*handle);
+        }
+    };
+    Node _node {};
+    std::chrono::nanoseconds _delay;
+    bool _canceled { false };
 public:
-    sleep() = default;
-    sleep(sleep&) = delete;
-    sleep(sleep&&) = delete;
-    sleep& operator=(sleep&) = delete;
-    sleep& operator=(sleep&&) = delete;
+    explicit sleep_for(std::chrono::nanoseconds delay) noexcept: _delay(delay) {}
+    sleep_for(sleep_for&) = delete;
+    sleep_for(sleep_for&&) = delete;
+    sleep_for& operator=(sleep_for&) = delete;
+    sleep_for& operator=(sleep_for&&) = delete;
 
     constexpr bool await_ready() const noexcept { return false; }
 
     template<typename P>
     requires concepts::Promise<P> || std::same_as<P, void>
     void await_suspend(std::coroutine_handle<P> handle) noexcept {
-        _timer = EventLoop::get().call_later(
-            std::chrono::milliseconds(MS),
-            [handle]() {
-                if (!handle.promise().canceled()) {
-                    handle.resume();
-                }
-            }
-        );
+        _node.handle = &handle.promise();
+        EventLoop::get().call_later(_delay, _node);
     }
 
     constexpr void await_resume() const noexcept {}
 
-    inline void cancel() noexcept { _timer->cancel(); }
+    inline void cancel() noexcept {
+        _canceled = true;
+        _node.unschedule();
+    }
 
-    inline bool canceled() const noexcept { return _timer->canceled(); }
+    inline bool canceled() const noexcept { return _canceled; }
+};
+
+
+template<uint64_t MS>
+class sleep: public sleep_for {
+public:
+    sleep() noexcept: sleep_for(std::chrono::milliseconds(MS)) {}
 };
 
 
@@ -79,5 +93,7 @@ static_assert(concepts::Awaitable<sleep<0>>, "sleep<0> not satisfy the Awaitable
 static_assert(concepts::Cancelable<sleep<0>>, "sleep<0> not satisfy the Cancelable concept");
 static_assert(concepts::Awaitable<sleep<1000>>, "sleep<1000> not satisfy the Awaitable concept");
 static_assert(concepts::Cancelable<sleep<1000>>, "sleep<1000> not satisfy the Cancelable concept");
+static_assert(concepts::Awaitable<sleep_for>, "sleep_for not satisfy the Awaitable concept");
+static_assert(concepts::Cancelable<sleep_for>, "sleep_for not satisfy the Cancelable concept");
 
 ASYNCIO_NS_END
@@ -1,9 +1,15 @@
 #pragma once
+#include <climits>
 #include <cstdio>
 #include <coroutine>
+#include <span>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/uio.h>
 
 #include "concepts.hpp"
 #include "epoll.hpp"
+#include "io_uring.hpp"
 #include "task.hpp"
 #include "asyncio_export.hpp"
 
@@ -16,6 +22,8 @@ class ASYNCIO_EXPORT Socket {
 private:
     class Reader;
     class Writer;
+    class VecWriter;
+    class FileSender;
     class Accepter;
     class Connecter;
 
@@ -31,12 +39,20 @@ public:
     ~Socket();
     Socket& operator=(Socket& s) noexcept;
     Socket& operator=(Socket&& s) noexcept;
+    [[nodiscard]] int reuse_port(bool enable = true) const noexcept;
+    [[nodiscard]] int busy_poll(int usecs) const noexcept;
     [[nodiscard]] int bind(const char* host, short port) noexcept;
     [[nodiscard]] int listen(int max_listen_num) const noexcept;
     [[nodiscard]] Connecter connect(const char* host, short port) const noexcept;
     [[nodiscard]] Accepter accept() const noexcept;
     [[nodiscard]] Reader read(char* buffer, size_t size) const noexcept;
-    [[nodiscard]] Task<void, const char*> write(const char* buffer, size_t size) const noexcept;
+    [[nodiscard]] Writer write(const char* buffer, size_t size) const noexcept;
+    /// gather write, the iovecs and their buffers must stay valid until it completes
+    [[nodiscard]] VecWriter writev(std::span<const iovec> iov) const noexcept;
+    /// send `count` bytes of `file_fd` from `offset` with sendfile(2), the
+    /// data never enters user space. the result is the bytes sent, short
+    /// only when the file ends first
+    [[nodiscard]] FileSender sendfile(int file_fd, off_t offset, size_t count) const noexcept;
     inline int fd() const noexcept { return _fd; };
 };
 
@@ -48,6 +64,12 @@ private:
     size_t _buffer_size { 0 };
     size_t _read_size { 0 };
     bool _closed { false };
+#if ASYNCIO_IO_URING
+    IoUring::OpID _op { IoUring::NO_OP };
+#else
+    /// handle waiting for the socket to be readable, 0 when none
+    Handle::ID _waiter { 0 };
+#endif
     Reader(int fd, char* buffer, size_t size);
     void _read_once() noexcept;
 public:
@@ -56,6 +78,7 @@ public:
     Reader(Reader&&) = delete;
     Reader& operator=(Reader&) = delete;
     Reader& operator=(Reader&&) = delete;
+    ~Reader() noexcept;
 
     inline bool await_ready() const noexcept {
         return _read_size > 0 or _closed;
@@ -63,15 +86,20 @@ public:
 
     template<typename P>
     requires concepts::Promise<P> || std::same_as<P, void>
-    void await_suspend(std::coroutine_handle<P> handle) const noexcept {
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+#if ASYNCIO_IO_URING
+        _op = IoUring::get().recv(_fd, _buffer, _buffer_size, handle.promise());
+#else
+        _waiter = handle.promise().id();
         auto& epoll = Epoll::get();
         epoll.add_reader(
             _fd,
-            handle.promise().id(),
+            _waiter,
             [h = &handle.promise()](){
                 h->run();
             }
         );
+#endif
     }
 
     [[nodiscard]] TaskResult<int, const char*> await_resume() noexcept;
@@ -79,14 +107,30 @@ public:
     // static_assert(concepts::Awaitable<Reader>, "Reader not satisfy the Awaitable concept");
 };
 
+/// writes the whole buffer. the first write is tried right away and the
+/// awaiter only suspends on a short one, so the common case costs a single
+/// syscall and no allocation. the rest is sent while the writer is awaited
+#if ASYNCIO_IO_URING
+class Socket::Writer: private IoUring::Completion {
+#else
 class Socket::Writer {
+#endif
     friend Socket;
 private:
     int _fd { -1 };
     const char* _buffer { nullptr };
     size_t _buffer_size { 0 };
     size_t _write_size { 0 };
-    bool _closed { false };
+    const char* _error { nullptr };
+    CoroHandle* _waiter { nullptr };
+#if ASYNCIO_IO_URING
+    IoUring::OpID _op { IoUring::NO_OP };
+
+    void _submit() noexcept;
+    void complete(IoUring::OpID op) noexcept override;
+#else
+    void _wait_writable() noexcept;
+#endif
     Writer(int fd, const char* buffer, size_t size);
     void _write_once() noexcept;
 public:
@@ -95,29 +139,123 @@ public:
     Writer(Writer&&) = delete;
     Writer& operator=(Writer&) = delete;
     Writer& operator=(Writer&&) = delete;
+    ~Writer() noexcept;
 
     inline bool await_ready() const noexcept {
-        return _write_size == _buffer_size or _closed;
+        return _write_size == _buffer_size or _error;
     }
 
     template<typename P>
     requires concepts::Promise<P> || std::same_as<P, void>
-    void await_suspend(std::coroutine_handle<P> handle) const noexcept {
-        auto& epoll = Epoll::get();
-        epoll.add_writer(
-            _fd,
-            handle.promise().id(),
-            [h = &handle.promise()](){
-                h->run();
-            }
-        );
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        _waiter = &handle.promise();
+#if ASYNCIO_IO_URING
+        _submit();
+#else
+        _wait_writable();
+#endif
     }
 
-    [[nodiscard]] TaskResult<int, const char*> await_resume() noexcept;
+    [[nodiscard]] TaskResult<void, const char*> await_resume() const noexcept;
 
     // static_assert(concepts::Awaitable<Writer>, "Writer not satisfy the Awaitable concept");
 };
 
+/// gather write of whole iovecs, built like `Writer`: the first write is
+/// tried right away and the waiter is only resumed once everything is sent
+/// or the write failed
+#if ASYNCIO_IO_URING
+class Socket::VecWriter: private IoUring::Completion {
+#else
+class Socket::VecWriter {
+#endif
+    friend Socket;
+private:
+    int _fd { -1 };
+    std::span<const iovec> _iov {};
+    /// first iovec not fully written and the bytes written of it
+    size_t _index { 0 };
+    size_t _offset { 0 };
+    size_t _written { 0 };
+    const char* _error { nullptr };
+    CoroHandle* _waiter { nullptr };
+#if ASYNCIO_IO_URING
+    msghdr _msg {};
+    IoUring::OpID _op { IoUring::NO_OP };
+
+    void _submit() noexcept;
+    void complete(IoUring::OpID op) noexcept override;
+#else
+    void _wait_writable() noexcept;
+#endif
+    VecWriter(int fd, std::span<const iovec> iov);
+    void _advance(size_t nbytes) noexcept;
+    void _write_once() noexcept;
+public:
+    VecWriter() = delete;
+    VecWriter(VecWriter&) = delete;
+    VecWriter(VecWriter&&) = delete;
+    VecWriter& operator=(VecWriter&) = delete;
+    VecWriter& operator=(VecWriter&&) = delete;
+    ~VecWriter() noexcept;
+
+    inline bool await_ready() const noexcept {
+        return _index == _iov.size() or _error;
+    }
+
+    template<typename P>
+    requires concepts::Promise<P> || std::same_as<P, void>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        _waiter = &handle.promise();
+#if ASYNCIO_IO_URING
+        _submit();
+#else
+        _wait_writable();
+#endif
+    }
+
+    /// total bytes written of the iovecs
+    [[nodiscard]] TaskResult<size_t, const char*> await_resume() const noexcept;
+};
+
+/// sendfile(2) is not offered by io_uring, so both backends wait for the
+/// socket to be writable through epoll
+class Socket::FileSender {
+    friend Socket;
+private:
+    int _fd { -1 };
+    int _file_fd { -1 };
+    off_t _offset { 0 };
+    size_t _count { 0 };
+    size_t _sent { 0 };
+    bool _eof { false };
+    const char* _error { nullptr };
+    CoroHandle* _waiter { nullptr };
+    FileSender(int fd, int file_fd, off_t offset, size_t count);
+    void _send_once() noexcept;
+    void _wait_writable() noexcept;
+public:
+    FileSender() = delete;
+    FileSender(FileSender&) = delete;
+    FileSender(FileSender&&) = delete;
+    FileSender& operator=(FileSender&) = delete;
+    FileSender& operator=(FileSender&&) = delete;
+    ~FileSender() noexcept;
+
+    inline bool await_ready() const noexcept {
+        return _sent == _count or _eof or _error;
+    }
+
+    template<typename P>
+    requires concepts::Promise<P> || std::same_as<P, void>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        _waiter = &handle.promise();
+        _wait_writable();
+    }
+
+    [[nodiscard]] TaskResult<size_t, const char*> await_resume() const noexcept;
+};
+
 class Socket::Accepter {
     friend Socket;
 private:
@@ -125,6 +263,9 @@ private:
     int _fd { -1 };
     const char* _host { nullptr };
     short _port { -1 };
+#if ASYNCIO_IO_URING
+    CoroHandle* _waiter { nullptr };
+#endif
     Accepter(int fd, const char* host, short port);
     void _accept_once() noexcept;
 public:
@@ -133,6 +274,7 @@ public:
     Accepter(Accepter&&) = delete;
     Accepter& operator=(Accepter&) = delete;
     Accepter& operator=(Accepter&&) = delete;
+    ~Accepter() noexcept;
 
     inline bool await_ready() const noexcept {
         return _conn != -1;
@@ -140,7 +282,11 @@ public:
 
     template<typename P>
     requires concepts::Promise<P> || std::same_as<P, void>
-    void await_suspend(std::coroutine_handle<P> handle) const noexcept {
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+#if ASYNCIO_IO_URING
+        _waiter = &handle.promise();
+        IoUring::get().wait_accept(_fd, *_waiter);
+#else
         auto& epoll = Epoll::get();
         epoll.add_reader(
             _fd,
@@ -149,6 +295,7 @@ public:
                 h->run();
             }
         );
+#endif
     }
 
     [[nodiscard]] int await_resume() noexcept;
@@ -161,6 +308,11 @@ class Socket::Connecter {
 private:
     int _res { -1 };
     int _fd { -1 };
+    bool _pending { false };
+#if ASYNCIO_IO_URING
+    sockaddr_in _addr {};
+    IoUring::OpID _op { IoUring::NO_OP };
+#endif
     Connecter(int fd, const char* host, short port);
 public:
     Connecter() = delete;
@@ -168,14 +320,18 @@ public:
     Connecter(Connecter&&) = delete;
     Connecter& operator=(Connecter&) = delete;
     Connecter& operator=(Connecter&&) = delete;
+    ~Connecter() noexcept;
 
     inline bool await_ready() const noexcept {
-        return _res != -1 || errno != EINPROGRESS;
+        return !_pending;
     }
 
     template<typename P>
     requires concepts::Promise<P> || std::same_as<P, void>
-    void await_suspend(std::coroutine_handle<P> handle) const noexcept {
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+#if ASYNCIO_IO_URING
+        _op = IoUring::get().connect(_fd, (sockaddr*)&_addr, sizeof(_addr), handle.promise());
+#else
         auto& epoll = Epoll::get();
         epoll.add_writer(
             _fd,
@@ -184,6 +340,7 @@ public:
                 h->run();
             }
         );
+#endif
     }
 
     [[nodiscard]] int await_resume() noexcept;
@@ -191,4 +348,70 @@ public:
     // static_assert(concepts::Awaitable<Connecter>, "Connecter not satisfy the Awaitable concept");
 };
 
+/// buffers many small writes of a socket: the writes issued during one loop
+/// iteration are copied and go out together in a single syscall right
+/// before the loop polls. while in use every write of the socket must go
+/// through the cork, `drain` waits until everything is sent
+class ASYNCIO_EXPORT Cork final: public FlushNode {
+private:
+    class Drainer;
+
+    Socket _socket;
+    std::vector<char> _buffer {};
+    size_t _sent { 0 };
+    const char* _error { nullptr };
+    /// the socket was full, the rest is sent once it is writable again
+    bool _writable_wait { false };
+    CoroHandle* _drainer { nullptr };
+
+    void _queue() noexcept;
+    void flush() noexcept override;
+public:
+    explicit Cork(Socket& socket) noexcept;
+    Cork(Cork&) = delete;
+    Cork(Cork&&) = delete;
+    Cork& operator=(Cork&) = delete;
+    Cork& operator=(Cork&&) = delete;
+    /// bytes not sent yet are dropped
+    ~Cork() noexcept;
+
+    void write(const char* buffer, size_t size) noexcept;
+    void writev(std::span<const iovec> iov) noexcept;
+    [[nodiscard]] Drainer drain() noexcept;
+    [[nodiscard]] inline size_t pending() const noexcept { return _buffer.size() - _sent; }
+    /// error of the socket, the buffered bytes are dropped once it is set
+    [[nodiscard]] inline const char* error() const noexcept { return _error; }
+};
+
+class Cork::Drainer {
+    friend Cork;
+private:
+    Cork& _cork;
+    bool _waiting { false };
+
+    Drainer(Cork& cork) noexcept: _cork(cork) {}
+public:
+    Drainer() = delete;
+    Drainer(Drainer&) = delete;
+    Drainer(Drainer&&) = delete;
+    Drainer& operator=(Drainer&) = delete;
+    Drainer& operator=(Drainer&&) = delete;
+    ~Drainer() noexcept {
+        if (_waiting) {
+            _cork._drainer = nullptr;
+        }
+    }
+
+    bool await_ready() const noexcept;
+
+    template<typename P>
+    requires concepts::Promise<P> || std::same_as<P, void>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        _waiting = true;
+        _cork._drainer = &handle.promise();
+    }
+
+    [[nodiscard]] TaskResult<void, const char*> await_resume() noexcept;
+};
+
 ASYNCIO_NS_END
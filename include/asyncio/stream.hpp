@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include "asyncio_ns.hpp"
+#include "asyncio_config.hpp"
+#include "asyncio_export.hpp"
+#include "lazy_task.hpp"
+#include "socket.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// buffered reads over a socket. every fill reads as much as the free space
+/// of the buffer allows, the returned spans point into the buffer and stay
+/// valid until the next read of the reader. the buffer grows by doubling up
+/// to `limit`, consumed bytes are reclaimed by moving the rest to the front
+class ASYNCIO_EXPORT StreamReader {
+public:
+    using Result = TaskResult<std::span<const char>, const char*>;
+private:
+    Socket _socket;
+    std::unique_ptr<char[]> _buf;
+    size_t _capacity;
+    size_t _limit;
+    size_t _begin { 0 };
+    size_t _end { 0 };
+    /// bytes handed out by the last read, dropped by the next one
+    size_t _consumed { 0 };
+    bool _eof { false };
+
+    void _consume() noexcept;
+    [[nodiscard]] bool _reserve(size_t size) noexcept;
+    [[nodiscard]] LazyTask<void, const char*> _fill() noexcept;
+    [[nodiscard]] std::span<const char> _take(size_t size) noexcept;
+public:
+    explicit StreamReader(
+        Socket& socket,
+        size_t size = STREAM_BUFFER_SIZE,
+        size_t limit = STREAM_BUFFER_LIMIT
+    ) noexcept;
+    StreamReader(StreamReader&) = delete;
+    StreamReader(StreamReader&&) = delete;
+    StreamReader& operator=(StreamReader&) = delete;
+    StreamReader& operator=(StreamReader&&) = delete;
+
+    /// buffered bytes, or the bytes of a single fill when none are
+    [[nodiscard]] LazyTask<std::span<const char>, const char*> read_some() noexcept;
+    /// exactly `size` bytes, fails if the peer closes before
+    [[nodiscard]] LazyTask<std::span<const char>, const char*> read_exactly(size_t size) noexcept;
+    /// bytes up to and including `delim`
+    [[nodiscard]] LazyTask<std::span<const char>, const char*> read_until(std::string_view delim) noexcept;
+    [[nodiscard]] inline LazyTask<std::span<const char>, const char*> read_line() noexcept {
+        return read_until("\n");
+    }
+
+    /// bytes received but not read yet
+    [[nodiscard]] inline std::span<const char> buffered() const noexcept {
+        return { _buf.get() + _begin + _consumed, _end - _begin - _consumed };
+    }
+    [[nodiscard]] inline size_t capacity() const noexcept { return _capacity; }
+    [[nodiscard]] inline bool at_eof() const noexcept { return _eof && buffered().empty(); }
+};
+
+ASYNCIO_NS_END
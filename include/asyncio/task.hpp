@@ -8,6 +8,7 @@
 #include "event_loop.hpp"
 #include "concepts.hpp"
 #include "handle.hpp"
+#include "frame_pool.hpp"
 #include "utils.hpp"
 
 
@@ -91,8 +92,9 @@ public:
 
     auto result() && noexcept {
         _check_valid();
-        auto handle = std::exchange(_handle, nullptr);
-        return std::move(handle.promise()).get_result();
+        // the task is consumed, its frame goes back to the pool right away
+        Task task { std::move(*this) };
+        return std::move(task._handle.promise()).get_result();
     }
 
     inline void cancel() const noexcept {
@@ -123,6 +125,12 @@ public:
     inline bool valid() const noexcept {
         return _handle != nullptr;
     }
+
+    /// promise of the task, used by combinators to join it
+    inline CoroHandle& coro_handle() const noexcept {
+        _check_valid();
+        return _handle.promise();
+    }
 };
 
 
@@ -184,13 +192,15 @@ public:
 
 
 template<typename R, typename E>
-struct Task<R, E>::Promise final: public PromiseResult<R, E>, public CoroHandle {
+struct Task<R, E>::Promise final: public PromiseResult<R, E>, public CoroHandle, public FrameAllocated {
     bool suspend_at_final { true };
     std::vector<Callback> done_callbacks {};
     std::source_location loc {};
     bool has_unhandled_exception { false };
 
-    Promise(std::source_location loc = std::source_location::current()): loc(loc) {}
+    Promise(std::source_location loc = std::source_location::current()): loc(loc) {
+        _coro = CorounineHandle::from_promise(*this);
+    }
 
     void schedule_callback() noexcept {
         if (!done_callbacks.empty()) {
@@ -250,16 +260,28 @@ struct Task<R, E>::Promise final: public PromiseResult<R, E>, public CoroHandle
         return {};
     }
 
+    /// a suspended child hands the thread straight to its parent through
+    /// symmetric transfer instead of queueing it for the next iteration
     struct FinalAwaiter {
         const bool suspend;
+        CoroHandle* const parent;
         bool await_ready() noexcept { return !suspend; }
-        template<typename P>
-        requires concepts::Promise<P> || std::is_void_v<P>
-        constexpr void await_suspend(std::coroutine_handle<P> handle) noexcept {}
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
+            if (parent) {
+                return parent->coroutine();
+            }
+            return std::noop_coroutine();
+        }
         constexpr void await_resume() noexcept {}
     };
     FinalAwaiter final_suspend() noexcept {
         auto& loop = EventLoop::get();
+        CoroHandle* parent = nullptr;
+        if constexpr (std::is_void_v<E>) {
+            report_completion(has_unhandled_exception);
+        } else {
+            report_completion(has_unhandled_exception || !this->result.has_value());
+        }
         if (has_unhandled_exception) {
             traceback(0);
             loop.stop();
@@ -267,11 +289,15 @@ struct Task<R, E>::Promise final: public PromiseResult<R, E>, public CoroHandle
             schedule_callback();
             if (loop.is_root(id())) {
                 loop.stop();
+            } else if (suspend_at_final && done_callbacks.empty()) {
+                parent = parent_to_resume();
             } else {
+                // done callbacks refer to the frame and must run before the
+                // parent may destroy it, so the parent is queued after them
                 try_resume_parent();
             }
         }
-        return { suspend_at_final };
+        return { suspend_at_final, parent };
     }
 
     constexpr void unhandled_exception() noexcept {
@@ -0,0 +1,181 @@
+#pragma once
+#include <array>
+#include <span>
+#include <vector>
+
+#include "asyncio_ns.hpp"
+#include "concepts.hpp"
+#include "handle.hpp"
+#include "task.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// awaits a set of tasks through one CompletionCounter living in the
+/// awaiter, so joining costs no allocation and no callback per task
+template<typename Range>
+class FanIn {
+protected:
+    Range _tasks;
+    CompletionCounter _counter;
+
+    static inline CoroHandle& _handle_of(CoroHandle* handle) noexcept { return *handle; }
+    template<typename R, typename E>
+    static inline CoroHandle& _handle_of(Task<R, E>& task) noexcept { return task.coro_handle(); }
+
+    /// index of the first task to finish
+    [[nodiscard]] size_t _first() const noexcept {
+        size_t i = 0;
+        for (auto& task : _tasks) {
+            if (_handle_of(task).id() == _counter.first()) {
+                break;
+            }
+            ++i;
+        }
+        return i;
+    }
+public:
+    FanIn(Range tasks, CompletionCounter::Wake wake) noexcept: _tasks(tasks), _counter(wake) {}
+    FanIn(FanIn&) = delete;
+    FanIn(FanIn&&) = delete;
+    FanIn& operator=(FanIn&) = delete;
+    FanIn& operator=(FanIn&&) = delete;
+
+    /// tasks still running when the awaiter goes away stop reporting to it
+    ~FanIn() noexcept {
+        for (auto& task : _tasks) {
+            _counter.remove(_handle_of(task));
+        }
+    }
+
+    bool await_ready() noexcept {
+        for (auto& task : _tasks) {
+            _counter.add(_handle_of(task));
+        }
+        return _counter.ready();
+    }
+
+    template<typename P>
+    requires concepts::Promise<P> || std::same_as<P, void>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        _counter.wait(handle.promise());
+    }
+};
+
+
+template<typename Range>
+class GatherAwaiter final: public FanIn<Range> {
+public:
+    using FanIn<Range>::FanIn;
+    constexpr void await_resume() const noexcept {}
+};
+
+
+template<typename Range>
+class WhenAnyAwaiter final: public FanIn<Range> {
+public:
+    using FanIn<Range>::FanIn;
+    /// index of the first task to finish
+    size_t await_resume() const noexcept { return this->_first(); }
+};
+
+
+/// wait until every task is done or canceled, results stay in the tasks
+template<typename... T>
+requires (concepts::Task<T> && ...)
+[[nodiscard]] inline auto gather(T&... tasks) noexcept {
+    using Range = std::array<CoroHandle*, sizeof...(T)>;
+    return GatherAwaiter<Range>(Range { &tasks.coro_handle()... }, CompletionCounter::Wake::All);
+}
+
+template<typename R, typename E>
+[[nodiscard]] inline auto gather(std::span<Task<R, E>> tasks) noexcept {
+    return GatherAwaiter<std::span<Task<R, E>>>(tasks, CompletionCounter::Wake::All);
+}
+
+/// wait until one task is done or canceled and return its index,
+/// the others keep running
+template<typename... T>
+requires (concepts::Task<T> && ...)
+[[nodiscard]] inline auto when_any(T&... tasks) noexcept {
+    using Range = std::array<CoroHandle*, sizeof...(T)>;
+    return WhenAnyAwaiter<Range>(Range { &tasks.coro_handle()... }, CompletionCounter::Wake::First);
+}
+
+template<typename R, typename E>
+[[nodiscard]] inline auto when_any(std::span<Task<R, E>> tasks) noexcept {
+    return WhenAnyAwaiter<std::span<Task<R, E>>>(tasks, CompletionCounter::Wake::First);
+}
+
+
+/// owns the tasks spawned into it. `join` waits for all of them, a task
+/// failing, with an unhandled exception or an unexpected result, cancels
+/// the others at once. unfinished tasks are canceled when the group is
+/// destroyed. its tasks can not be awaited by `gather` or `when_any`
+template<typename R = void, typename E = void>
+class TaskGroup {
+private:
+    std::vector<Task<R, E>> _tasks {};
+    CompletionCounter _counter { CompletionCounter::Wake::Error, [this] { _cancel_running(); } };
+
+    /// the failed task is still in its final suspend and not done yet, it
+    /// has stopped reporting to the counter though
+    void _cancel_running() noexcept {
+        for (auto& task : _tasks) {
+            if (task.coro_handle().counter() == &_counter) {
+                task.cancel();
+            }
+        }
+    }
+
+    struct JoinAwaiter {
+        TaskGroup& group;
+
+        bool await_ready() const noexcept {
+            return group._counter.ready();
+        }
+
+        template<typename P>
+        requires concepts::Promise<P> || std::same_as<P, void>
+        void await_suspend(std::coroutine_handle<P> handle) const noexcept {
+            group._counter.wait(handle.promise());
+        }
+
+        /// true if no task failed
+        bool await_resume() const noexcept {
+            return !group._counter.failed();
+        }
+    };
+public:
+    TaskGroup() noexcept = default;
+    TaskGroup(TaskGroup&) = delete;
+    TaskGroup(TaskGroup&&) = delete;
+    TaskGroup& operator=(TaskGroup&) = delete;
+    TaskGroup& operator=(TaskGroup&&) = delete;
+
+    ~TaskGroup() noexcept {
+        cancel();
+    }
+
+    /// take ownership of `task`, return its index in `tasks()`
+    size_t spawn(Task<R, E>&& task) noexcept {
+        _counter.add(task.coro_handle());
+        _tasks.push_back(std::move(task));
+        return _tasks.size() - 1;
+    }
+
+    /// cancel every unfinished task
+    void cancel() noexcept {
+        for (auto& task : _tasks) {
+            if (!task.done() && !task.canceled()) {
+                task.cancel();
+            }
+        }
+    }
+
+    [[nodiscard]] inline JoinAwaiter join() noexcept { return { *this }; }
+    [[nodiscard]] inline std::span<Task<R, E>> tasks() noexcept { return _tasks; }
+    [[nodiscard]] inline size_t size() const noexcept { return _tasks.size(); }
+};
+
+ASYNCIO_NS_END
@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 
 #include "handle.hpp"
 #include "types.hpp"
@@ -12,26 +13,72 @@ ASYNCIO_NS_BEGIN()
 using namespace types;
 
 class EventLoop;
-class ASYNCIO_EXPORT Timer: public Handle {
+class TimerQueue;
+class TimerHeap;
+class TimerWheel;
+
+/// intrusive timer, an awaiter embeds it in its own storage so that scheduling
+/// and firing it performs no allocation.
+/// it unlinks itself from the loop when destroyed while still scheduled
+class ASYNCIO_EXPORT TimerNode {
+    friend EventLoop;
+    friend TimerQueue;
+    friend TimerHeap;
+    friend TimerWheel;
+public:
+    TimerNode() noexcept = default;
+    TimerNode(TimerNode&) = delete;
+    TimerNode(TimerNode&&) = delete;
+    TimerNode& operator=(TimerNode&) = delete;
+    TimerNode& operator=(TimerNode&&) = delete;
+    virtual ~TimerNode() noexcept;
+
+    /// remove the node from its queue if still scheduled
+    void unschedule() noexcept;
+    inline bool scheduled() const noexcept { return _queue != nullptr; }
+    inline TimePoint when() const noexcept { return _when; }
+protected:
+    TimePoint _when {};
+
+    /// called by the event loop once the deadline is reached
+    virtual void expire() noexcept = 0;
+    /// called when the queue drops the node without firing it
+    virtual void release() noexcept {}
+    /// cancel while scheduled, the queue may keep it as a tombstone
+    void _cancel() noexcept;
+private:
+    // queue the node is scheduled in, reset once it leaves
+    TimerQueue* _queue { nullptr };
+
+    // hooks used by TimerHeap
+    size_t _index { 0 };
+    bool _tombstone { false };
+
+    // hooks used by TimerWheel
+    TimerNode* _prev { nullptr };
+    TimerNode* _next { nullptr };
+    uint64_t _tick { 0 };
+    uint8_t _level { 0 };
+    uint8_t _slot { 0 };
+};
+
+
+/// timer owned by a std::shared_ptr, used for callbacks
+class ASYNCIO_EXPORT Timer: public Handle, public TimerNode {
     friend EventLoop;
 public:
-    struct Compare;
     Timer(Timer&& timer);
     Timer(TimePoint when, EventLoopCallback&& callback);
     Timer& operator=(Timer&& timer) noexcept;
     void cancel() noexcept override;
     void run() noexcept override;
+protected:
+    void expire() noexcept override;
+    void release() noexcept override;
 private:
-    static size_t _canceled_count;
-    TimePoint _when;
     EventLoopCallback _callback { nullptr };
-};
-
-
-struct Timer::Compare {
-    inline bool operator()(const std::shared_ptr<Timer>& a, const std::shared_ptr<Timer>& b) {
-        return a->_when > b->_when;
-    }
+    // the queue keeps the timer alive through it while scheduled
+    std::shared_ptr<Timer> _keepalive { nullptr };
 };
 
 static_assert(concepts::Cancelable<Timer>, "Timer not satisfy the Cancelable concept");
@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "timer.hpp"
+#include "types.hpp"
+#include "asyncio_ns.hpp"
+#include "asyncio_export.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+using namespace types;
+
+/// storage of scheduled timers behind EventLoop::call_at/call_later,
+/// nodes are linked intrusively and never owned by the queue
+class ASYNCIO_EXPORT TimerQueue {
+public:
+    TimerQueue() noexcept = default;
+    TimerQueue(TimerQueue&) = delete;
+    TimerQueue(TimerQueue&&) = delete;
+    TimerQueue& operator=(TimerQueue&) = delete;
+    TimerQueue& operator=(TimerQueue&&) = delete;
+    virtual ~TimerQueue() noexcept = default;
+
+    virtual void push(TimerNode& node) noexcept = 0;
+    /// drop a scheduled node, it may be kept as tombstone until popped
+    virtual void cancel(TimerNode& node) noexcept = 0;
+    /// unlink a scheduled node right now, without releasing it
+    virtual void remove(TimerNode& node) noexcept = 0;
+    /// deadline of the earliest node, never later than the real deadline
+    [[nodiscard]] virtual std::optional<TimePoint> next_when() noexcept = 0;
+    /// move every node due at `end` into `expired`
+    virtual void pop_expired(TimePoint end, std::vector<TimerNode*>& expired) noexcept = 0;
+    [[nodiscard]] virtual size_t size() const noexcept = 0;
+    virtual void clear() noexcept = 0;
+
+    /// nodes canceled or unscheduled before they were due
+    [[nodiscard]] inline uint64_t dropped() const noexcept { return _dropped; }
+    /// passes purging tombstones
+    [[nodiscard]] inline uint64_t compactions() const noexcept { return _compactions; }
+protected:
+    uint64_t _dropped { 0 };
+    uint64_t _compactions { 0 };
+
+    inline void attach(TimerNode& node) noexcept { node._queue = this; }
+    inline void detach(TimerNode& node) noexcept { node._queue = nullptr; }
+    inline void release(TimerNode& node) noexcept {
+        node._queue = nullptr;
+        node.release();
+    }
+};
+
+
+/// binary heap with lazily removed canceled timers
+class ASYNCIO_EXPORT TimerHeap final: public TimerQueue {
+public:
+    ~TimerHeap() noexcept override;
+    void push(TimerNode& node) noexcept override;
+    void cancel(TimerNode& node) noexcept override;
+    void remove(TimerNode& node) noexcept override;
+    [[nodiscard]] std::optional<TimePoint> next_when() noexcept override;
+    void pop_expired(TimePoint end, std::vector<TimerNode*>& expired) noexcept override;
+    [[nodiscard]] inline size_t size() const noexcept override { return _heap.size() - _canceled_count; }
+    void clear() noexcept override;
+private:
+    std::vector<TimerNode*> _heap {};
+    size_t _canceled_count { 0 };
+
+    inline void _set(size_t i, TimerNode* node) noexcept {
+        _heap[i] = node;
+        node->_index = i;
+    }
+    void _sift_up(size_t i) noexcept;
+    void _sift_down(size_t i) noexcept;
+    TimerNode* _erase(size_t i) noexcept;
+};
+
+
+/// hierarchical timing wheel with O(1) push and cancel,
+/// LEVELS levels of SLOTS slots, each slot is an intrusive list of timers
+class ASYNCIO_EXPORT TimerWheel final: public TimerQueue {
+public:
+    static constexpr size_t LEVEL_BITS = 6;
+    static constexpr size_t SLOTS = 1 << LEVEL_BITS;
+    static constexpr size_t LEVELS = 6;
+    static constexpr uint64_t MAX_TICKS = (uint64_t)1 << (LEVEL_BITS * LEVELS);
+
+    explicit TimerWheel(std::chrono::nanoseconds tick = std::chrono::milliseconds(1)) noexcept;
+    ~TimerWheel() noexcept override;
+    void push(TimerNode& node) noexcept override;
+    void cancel(TimerNode& node) noexcept override;
+    void remove(TimerNode& node) noexcept override;
+    [[nodiscard]] std::optional<TimePoint> next_when() noexcept override;
+    void pop_expired(TimePoint end, std::vector<TimerNode*>& expired) noexcept override;
+    [[nodiscard]] inline size_t size() const noexcept override { return _size; }
+    void clear() noexcept override;
+private:
+    struct List {
+        TimerNode* head { nullptr };
+        TimerNode* tail { nullptr };
+    };
+    struct Level {
+        uint64_t occupied { 0 };
+        std::array<List, SLOTS> slots {};
+    };
+    struct Expiration {
+        size_t level;
+        size_t slot;
+        uint64_t deadline;
+    };
+
+    TimePoint _origin;
+    std::chrono::nanoseconds _tick;
+    uint64_t _elapsed { 0 };
+    size_t _size { 0 };
+    std::array<Level, LEVELS> _levels {};
+    // nodes already due when pushed
+    List _pending {};
+
+    [[nodiscard]] uint64_t _to_tick(TimePoint when, bool ceil) const noexcept;
+    [[nodiscard]] std::optional<Expiration> _next_expiration() const noexcept;
+    void _insert(TimerNode& node) noexcept;
+    void _unlink(TimerNode& node) noexcept;
+    List& _list_of(TimerNode& node) noexcept;
+};
+
+ASYNCIO_NS_END
@@ -4,11 +4,13 @@
 #include <functional>
 
 #include "asyncio_ns.hpp"
+#include "asyncio_config.hpp"
+#include "callback.hpp"
 
 
 ASYNCIO_NS_BEGIN(types)
 
-using EventLoopCallback = std::function<void()>;
+using EventLoopCallback = InplaceCallback<CALLBACK_CAPACITY>;
 using Clock = std::chrono::steady_clock;
 using TimePoint = std::chrono::time_point<Clock>;
 
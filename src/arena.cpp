@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "asyncio/arena.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+static inline std::byte* align_up(std::byte* ptr, size_t align) noexcept {
+    return reinterpret_cast<std::byte*>((reinterpret_cast<uintptr_t>(ptr) + align - 1) & ~(align - 1));
+}
+
+Arena::Arena(size_t chunk_size) noexcept: _chunk_size(chunk_size) {
+    //
+}
+
+Arena::~Arena() noexcept {
+    reset();
+    if (_chunks) {
+        ::operator delete(_chunks, _chunks->size);
+    }
+}
+
+void Arena::_grow(size_t size) {
+    auto chunk_size = std::max(_chunk_size, size + sizeof(Chunk));
+    auto chunk = new (::operator new(chunk_size)) Chunk { _chunks, chunk_size };
+    _chunks = chunk;
+    _cur = reinterpret_cast<std::byte*>(chunk + 1);
+    _end = reinterpret_cast<std::byte*>(chunk) + chunk_size;
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    auto ptr = align_up(_cur, align);
+    if (!_cur || ptr + size > _end) {
+        _grow(size + align);
+        ptr = align_up(_cur, align);
+    }
+    _cur = ptr + size;
+    _used += size;
+    return ptr;
+}
+
+void Arena::reset() noexcept {
+    if (!_chunks) {
+        return;
+    }
+    auto chunk = _chunks->next;
+    while (chunk) {
+        auto next = chunk->next;
+        ::operator delete(chunk, chunk->size);
+        chunk = next;
+    }
+    _chunks->next = nullptr;
+    _cur = reinterpret_cast<std::byte*>(_chunks + 1);
+    _end = reinterpret_cast<std::byte*>(_chunks) + _chunks->size;
+    _used = 0;
+}
+
+ASYNCIO_NS_END
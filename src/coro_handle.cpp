@@ -1,3 +1,5 @@
+#include <utility>
+
 #include <spdlog/fmt/fmt.h>
 
 #include "asyncio/event_loop.hpp"
@@ -11,9 +13,11 @@ void CoroHandle::set_parent(CoroHandle& handle) noexcept {
     _parent = &handle;
 }
 
-void CoroHandle::try_resume_parent() const noexcept {
+/// parent waiting on this coroutine, nullptr if there is none or it is
+/// canceled. cancellation of an ancestor is propagated down to the parent
+CoroHandle* CoroHandle::parent_to_resume() const noexcept {
     if (!_parent) {
-        return;
+        return nullptr;
     }
 
     auto h = _parent;
@@ -29,8 +33,26 @@ void CoroHandle::try_resume_parent() const noexcept {
         h = h->_parent;
     }
 
-    if (!_parent->canceled()) {
-        EventLoop::get().call_soon(*_parent);
+    return _parent->canceled() ? nullptr : _parent;
+}
+
+void CoroHandle::try_resume_parent() const noexcept {
+    if (auto parent = parent_to_resume()) {
+        EventLoop::get().call_soon(*parent);
+    }
+}
+
+void CoroHandle::cancel() noexcept {
+    Handle::cancel();
+    if (auto counter = std::exchange(_counter, nullptr)) {
+        counter->complete(*this, false);
+    }
+}
+
+void CoroHandle::report_completion(bool failed) noexcept {
+    _failed = failed;
+    if (auto counter = std::exchange(_counter, nullptr)) {
+        counter->complete(*this, failed);
     }
 }
 
@@ -42,4 +64,42 @@ void CoroHandle::traceback(int depth) const noexcept {
     }
 }
 
+
+void CompletionCounter::add(CoroHandle& child) noexcept {
+    if (child.coroutine().done() || child.canceled()) {
+        _pending++;
+        complete(child, child.failed());
+        return;
+    }
+    if (child.counter()) {
+        child.traceback(0);
+        utils::abort("task already reports to a completion counter");
+    }
+    child.set_counter(this);
+    _pending++;
+}
+
+void CompletionCounter::complete(const CoroHandle& child, bool failed) noexcept {
+    _pending--;
+    if (!_first) {
+        _first = child.id();
+    }
+    if (failed && !_failed) {
+        _failed = child.id();
+        if (_on_failure) {
+            _on_failure();
+        }
+    }
+    if (_waiter && ready()) {
+        EventLoop::get().call_soon(*std::exchange(_waiter, nullptr));
+    }
+}
+
+void CompletionCounter::remove(CoroHandle& child) noexcept {
+    if (child.counter() == this) {
+        child.set_counter(nullptr);
+        _pending--;
+    }
+}
+
 ASYNCIO_NS_END
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cstring>
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include <spdlog/spdlog.h>
 
@@ -21,112 +24,177 @@ Epoll::~Epoll() noexcept {
 }
 
 void Epoll::clear() noexcept {
+    if (auto fd = std::exchange(_timerfd, -1); fd != -1) {
+        close(fd);
+    }
     if (auto fd = std::exchange(_fd, -1); fd != -1) {
         close(fd);
         SPDLOG_INFO("close epoll fd {}", fd);
     }
-    _map.clear();
+    _events.clear();
+    _callbacks.clear();
 }
 
 Epoll& Epoll::get() noexcept {
-    static Epoll epoll;
+    static thread_local Epoll epoll;
     return epoll;
 }
 
-void Epoll::add_reader(int fd, Handle::ID id, EventLoopCallback&& cb) noexcept {
-    Event* event;
-    int op;
-    if (_map.contains(fd)) {
-        event = &_map[fd];
-        event->event.events |= EPOLLIN;
-        op = EPOLL_CTL_MOD;
-    } else {
-        event = &(_map[fd] = {});
-        event->event.data.ptr = event;
-        event->event.events = EPOLLIN | EPOLLET;
-        op = EPOLL_CTL_ADD;
+/// wait with nanosecond precision, a negative timeout blocks until an event
+int Epoll::wait(epoll_event* events, int event_num, std::chrono::nanoseconds timeout) noexcept {
+    static thread_local bool has_pwait2 = true;
+    if (timeout.count() <= 0) {
+        return epoll_wait(fd(), events, event_num, timeout.count() < 0 ? -1 : 0);
     }
-    if (event->reader.has_value()) {
-        utils::abort("repeatly add reader for fd {}", fd);
+    if (has_pwait2) {
+        auto sec = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+        timespec ts { .tv_sec = sec.count(), .tv_nsec = (timeout - sec).count() };
+        auto num = epoll_pwait2(fd(), events, event_num, &ts, nullptr);
+        if (num != -1 || errno != ENOSYS) {
+            return num;
+        }
+        has_pwait2 = false;
+        SPDLOG_WARN("epoll_pwait2 is not supported, fall back to timerfd");
     }
-    event->reader = { id, std::move(cb) };
-    if (epoll_ctl(this->fd(), op, fd, &event->event) == -1) {
-        utils::abort("failed to add reader for fd {}", fd);
+    return _wait_timerfd(events, event_num, timeout);
+}
+
+/// the timerfd sits in epoll with an invalid fd index, so `from` skips it
+int Epoll::_wait_timerfd(epoll_event* events, int event_num, std::chrono::nanoseconds timeout) noexcept {
+    if (_timerfd == -1) {
+        _timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        epoll_event ev { .events = EPOLLIN | EPOLLET, .data = { .u64 = (uint64_t)-1 } };
+        if (_timerfd == -1 || epoll_ctl(fd(), EPOLL_CTL_ADD, _timerfd, &ev) == -1) {
+            utils::abort("failed to create timerfd: {}", strerror(errno));
+        }
     }
-    SPDLOG_DEBUG("successfully add reader for fd {}", fd);
+    auto sec = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    itimerspec spec { .it_interval = {}, .it_value = { .tv_sec = sec.count(), .tv_nsec = (timeout - sec).count() } };
+    timerfd_settime(_timerfd, 0, &spec, nullptr);
+    auto num = epoll_wait(fd(), events, event_num, -1);
+    // disarm, a stale expiration would only cause a spurious wakeup
+    spec = {};
+    timerfd_settime(_timerfd, 0, &spec, nullptr);
+    return num;
 }
 
-void Epoll::add_writer(int fd, Handle::ID id, EventLoopCallback&& cb) noexcept {
-    Event* event;
-    int op;
-    if (_map.contains(fd)) {
-        event = &_map[fd];
-        event->event.events |= EPOLLOUT;
-        op = EPOLL_CTL_MOD;
-    } else {
-        event = &(_map[fd] = {});
-        event->event.data.ptr = event;
-        op = EPOLL_CTL_ADD;
-        event->event.events = EPOLLOUT | EPOLLET;
+Epoll::Event* Epoll::_find(int fd) noexcept {
+    if ((size_t)fd < _events.size() && _events[fd].registered) {
+        return &_events[fd];
     }
-    if (event->writer.has_value()) {
-        utils::abort("repeatly add writer for fd {}", fd);
+    return nullptr;
+}
+
+/// register fd for its lifetime, an fd closed without `clear_fd` leaves the
+/// kernel registration of a reused number behind, so EEXIST is fine
+Epoll::Event& Epoll::_register(int fd) noexcept {
+    if ((size_t)fd >= _events.size()) {
+        _events.resize(std::max<size_t>(fd + 1, _events.size() * 2));
+        _callbacks.resize(_events.size());
+    }
+    auto& event = _events[fd];
+    if (event.registered) {
+        return event;
     }
-    event->writer = { id, std::move(cb) };
-    if (epoll_ctl(this->fd(), op, fd, &event->event) == -1) {
-        utils::abort("failed to add writer for fd {}", fd);
+    event.registered = true;
+    event.ready = EPOLLIN | EPOLLOUT;
+    epoll_event ev { .events = Event::EVENTS, .data = { .u64 = ((uint64_t)event.generation << 32) | (uint32_t)fd } };
+    if (epoll_ctl(this->fd(), EPOLL_CTL_ADD, fd, &ev) == -1) {
+        if (errno != EEXIST || epoll_ctl(this->fd(), EPOLL_CTL_MOD, fd, &ev) == -1) {
+            utils::abort("failed to register fd {}", fd);
+        }
     }
-    SPDLOG_DEBUG("successfully add writer for fd {}", fd);
+    SPDLOG_DEBUG("successfully register fd {}", fd);
+    return event;
 }
 
-void Epoll::remove_reader(int fd) noexcept {
-    if (!_map.contains(fd)) {
-        utils::abort("fd {} not register yet", fd);
+int Epoll::from(const epoll_event& ev) const noexcept {
+    auto fd = (int)(uint32_t)ev.data.u64;
+    if ((size_t)fd < _events.size() && _events[fd].registered && _events[fd].generation == (uint32_t)(ev.data.u64 >> 32)) {
+        return fd;
+    }
+    return -1;
+}
+
+void Epoll::mark_ready(int fd, uint32_t events) noexcept {
+    _events[fd].ready |= events;
+}
+
+Epoll::Callbacks& Epoll::callbacks(int fd) noexcept {
+    return _callbacks[fd];
+}
+
+/// the callback is one-shot, it is moved into the ready queue on the next
+/// readiness edge of fd, no epoll_ctl is needed
+void Epoll::add_reader(int fd, Handle::ID id, EventLoopCallback&& cb) noexcept {
+    _register(fd);
+    auto& callbacks = _callbacks[fd];
+    if (callbacks.reader.has_value()) {
+        utils::abort("repeatly add reader for fd {}", fd);
     }
-    if (!_map[fd].reader) {
-        SPDLOG_WARN("reader of fd {} not registered", fd);
+    callbacks.reader = { id, std::move(cb) };
+}
+
+void Epoll::add_writer(int fd, Handle::ID id, EventLoopCallback&& cb) noexcept {
+    _register(fd);
+    auto& callbacks = _callbacks[fd];
+    if (callbacks.writer.has_value()) {
+        utils::abort("repeatly add writer for fd {}", fd);
     }
-    _map[fd].reader = std::nullopt;
-    _map[fd].event.events &= ~EPOLLIN;
-    if (_map[fd].writer) {
-        if (epoll_ctl(this->fd(), EPOLL_CTL_MOD, fd, &_map[fd].event) == -1) {
-            utils::abort("failed to ctl fd {}", fd);
-        }
+    callbacks.writer = { id, std::move(cb) };
+}
+
+void Epoll::remove_reader(int fd) noexcept {
+    if (_find(fd)) {
+        _callbacks[fd].reader.reset();
     } else {
-        _map.erase(fd);
-        if (epoll_ctl(this->fd(), EPOLL_CTL_DEL, fd, nullptr) == -1) {
-            utils::abort("failed to remove reader for fd {}", fd);
-        }
+        utils::abort("fd {} not register yet", fd);
     }
-    SPDLOG_DEBUG("successfully remove reader for fd {}", fd);
 }
 
 void Epoll::remove_writer(int fd) noexcept {
-    if (!_map.contains(fd)) {
+    if (_find(fd)) {
+        _callbacks[fd].writer.reset();
+    } else {
         utils::abort("fd {} not register yet", fd);
     }
-    if (!_map[fd].writer) {
-        SPDLOG_WARN("writer of fd {} not registered", fd);
-    }
-    _map[fd].writer = std::nullopt;
-    _map[fd].event.events &= ~EPOLLOUT;
-    if (_map[fd].reader) {
-        if (epoll_ctl(this->fd(), EPOLL_CTL_MOD, fd, &_map[fd].event) == -1) {
-            utils::abort("failed to ctl fd {}", fd);
+}
+
+void Epoll::cancel_reader(int fd, Handle::ID id) noexcept {
+    if (_find(fd)) {
+        if (auto& reader = _callbacks[fd].reader; reader.has_value() && reader->id == id) {
+            reader.reset();
         }
-    } else {
-        _map.erase(fd);
-        if (epoll_ctl(this->fd(), EPOLL_CTL_DEL, fd, nullptr) == -1) {
-            utils::abort("failed to remove writer for fd {}", fd);
+    }
+}
+
+void Epoll::cancel_writer(int fd, Handle::ID id) noexcept {
+    if (_find(fd)) {
+        if (auto& writer = _callbacks[fd].writer; writer.has_value() && writer->id == id) {
+            writer.reset();
         }
     }
-    SPDLOG_DEBUG("successfully remove writer for fd {}", fd);
 }
 
+/// readiness of an unregistered fd is unknown, it counts as ready
+uint32_t Epoll::ready(int fd) const noexcept {
+    if ((size_t)fd < _events.size() && _events[fd].registered) {
+        return _events[fd].ready;
+    }
+    return EPOLLIN | EPOLLOUT;
+}
+
+void Epoll::clear_ready(int fd, uint32_t events) noexcept {
+    _register(fd).ready &= ~events;
+}
+
+/// the fd may already be closed, then the kernel dropped it by itself
 void Epoll::clear_fd(int fd) noexcept {
-    if (_map.contains(fd)) {
-        _map.erase(fd);
-        if (epoll_ctl(this->fd(), EPOLL_CTL_DEL, fd, nullptr) == -1) {
+    if (auto event = _find(fd)) {
+        event->registered = false;
+        event->generation += 1;
+        _callbacks[fd] = {};
+        if (epoll_ctl(this->fd(), EPOLL_CTL_DEL, fd, nullptr) == -1 && errno != EBADF && errno != ENOENT) {
             utils::abort("failed to clear fd {}", fd);
         }
     }
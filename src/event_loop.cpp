@@ -1,130 +1,380 @@
-#define _MIN_SCHEDULED_TIMER_HANDLES 100
-#define _MIN_CANCELLED_TIMER_HANDLES_FRACTION 0.5
 #include <algorithm>
+#include <atomic>
 #include <csignal>
+#include <cstring>
+#include <sched.h>
 #include <sys/eventfd.h>
 
 #include <spdlog/spdlog.h>
 
 #include "asyncio_config.hpp"
 #include "asyncio/epoll.hpp"
+#include "asyncio/io_uring.hpp"
 #include "asyncio/event_loop.hpp"
+#include "asyncio/utils.hpp"
 
 
 ASYNCIO_NS_BEGIN()
 
-static auto clock_resolution = std::chrono::milliseconds(
-    1000 * Clock::period::num / Clock::period::den
-);
+/// timers due within the resolution of the monotonic clock are expired
+static const auto clock_resolution = [] {
+    timespec res {};
+    clock_getres(CLOCK_MONOTONIC, &res);
+    return std::chrono::seconds(res.tv_sec) + std::chrono::nanoseconds(res.tv_nsec);
+}();
+
+/// SIGINT may be delivered to any thread, so the handler only bumps a counter
+/// and writes a process-wide eventfd that every running loop listens on
+static std::atomic<uint64_t> interrupt_count { 0 };
+static std::atomic<int> interrupt_eventfd { -1 };
 
 static void signal_handle(int sig) noexcept {
     if (sig == SIGINT) {
-        EventLoop::get().stop();
-        SPDLOG_WARN("receive SIGINT signal");
+        interrupt_count.fetch_add(1);
+        if (auto fd = interrupt_eventfd.load(); fd != -1) {
+            eventfd_write(fd, 1);
+        }
     }
 }
 
-EventLoop::EventLoop() noexcept {
-    signal(SIGINT, signal_handle);
+static int init_interrupt_eventfd() noexcept {
+    static int fd = [] {
+        auto fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        interrupt_eventfd.store(fd);
+        signal(SIGINT, signal_handle);
+        return fd;
+    }();
+    return fd;
+}
+
+EventLoop::EventLoop() noexcept:
+#if ASYNCIO_TIMER_WHEEL
+    _schedule(std::make_unique<TimerWheel>(std::chrono::microseconds(TIMER_WHEEL_TICK_US)))
+#else
+    _schedule(std::make_unique<TimerHeap>())
+#endif
+{
+    _events.resize(MIN_EVENTS_NUM);
+    init_interrupt_eventfd();
 }
 
-/// create event loop
+/// create event loop, one per thread
 EventLoop& EventLoop::get() noexcept {
-    static EventLoop loop;
+    static thread_local EventLoop loop;
     return loop;
 }
 
+/// listen on the shared interrupt eventfd, it is never drained so that
+/// every loop gets its own edge notification
+void EventLoop::_init_interrupt() noexcept {
+    _interrupt_seen = interrupt_count.load();
+    _watch_interrupt();
+}
+
+/// epoll readers are one-shot, so the watcher registers itself again
+void EventLoop::_watch_interrupt() noexcept {
+    Epoll::get().add_reader(init_interrupt_eventfd(), 0, [this] {
+        if (interrupt_count.load() != _interrupt_seen) {
+            SPDLOG_WARN("receive SIGINT signal");
+            stop();
+        }
+        _watch_interrupt();
+    });
+}
+
 /// initialze eventfd for thread
 void EventLoop::_init_thread_eventfd() noexcept {
     if (_eventfd == -1) {
         _eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
         SPDLOG_INFO("successfully create eventfd {}", _eventfd);
-        Epoll::get().add_reader(_eventfd, 0, [eventfd = _eventfd] {
-            eventfd_t value;
-            eventfd_read(eventfd, &value);
-        });
+        _watch_eventfd();
     }
 }
 
-/// process events of epoll
-void EventLoop::_process_epoll(int timeout) noexcept {
+void EventLoop::_watch_eventfd() noexcept {
+    Epoll::get().add_reader(_eventfd, 0, [this] {
+        eventfd_t value;
+        eventfd_read(_eventfd, &value);
+        _watch_eventfd();
+    });
+}
+
+#if ASYNCIO_IO_URING
+/// the ring fd turns readable when completions are posted, they are reaped
+/// after every epoll wait so the watcher only needs to stay registered
+void EventLoop::_watch_io_uring() noexcept {
+    Epoll::get().add_reader(IoUring::get().fd(), 0, [this] {
+        _watch_io_uring();
+    });
+}
+#endif
+
+/// wake up the loop if it is parked in epoll_wait, called from other threads
+void EventLoop::_wakeup() noexcept {
+    if (_sleeping.exchange(false)) {
+        eventfd_write(_eventfd, 1);
+    }
+}
+
+/// wait for epoll events. in busy-poll mode the loop first spins on a zero
+/// timeout epoll_wait for twice the average idle gap and only parks when that
+/// runs out; when gaps grow beyond the configured budget spinning would not
+/// pay off, the loop then parks at once until the gaps shrink again
+int EventLoop::_poll(std::chrono::nanoseconds timeout) noexcept {
     auto& epoll = Epoll::get();
-    epoll_event events[MAX_EVENTS_NUM];
-    auto num = epoll.wait(events, MAX_EVENTS_NUM, timeout);
-    for (int i = 0; i < num; i++) {
-        auto ev = (Epoll::Event*)events[i].data.ptr;
-        if ((events[i].events & EPOLLIN) && ev->reader.has_value()) {
-            _ready.push(*ev->reader);
+    if (timeout.count() == 0 || _busy_poll.count() == 0) {
+        return _park(timeout);
+    }
+    auto start = _time();
+    int num = 0;
+    if (auto spin = _idle_gap * 2; spin <= _busy_poll) {
+        auto spin_end = start + spin;
+        if (timeout.count() > 0) {
+            spin_end = std::min(spin_end, start + timeout);
+        }
+        // yielding lets a peer sharing this cpu produce the awaited event
+        while ((num = epoll.wait(_events.data(), (int)_events.size(), {})) == 0 && _inbox.empty() && _time() < spin_end) {
+            sched_yield();
         }
-        if ((events[i].events & EPOLLOUT) && ev->writer.has_value()) {
-            _ready.push(*ev->writer);
+    }
+    if (num == 0 && _inbox.empty()) {
+        if (timeout.count() > 0) {
+            timeout = std::max(timeout - (_time() - start), std::chrono::nanoseconds(0));
         }
+        num = _park(timeout);
     }
+    _idle_gap += (_time() - start - _idle_gap) / 8;
+    return num;
 }
 
-/// run once loop
-void EventLoop::_run_once() noexcept {
-    if (
-        _schedule.size() > _MIN_SCHEDULED_TIMER_HANDLES
-        && Timer::_canceled_count / (double)_schedule.size() > _MIN_CANCELLED_TIMER_HANDLES_FRACTION
-    ) {
-        decltype(_schedule) schedule;
-        schedule.reserve(_schedule.size() - Timer::_canceled_count);
-        for (auto& timer : _schedule) {
-            if (!timer->canceled()) {
-                schedule.push_back(timer);
-            }
+/// block in epoll_wait, producers of `call_soon_threadsafe` wake it up
+int EventLoop::_park(std::chrono::nanoseconds timeout) noexcept {
+    if (timeout.count() != 0) {
+        _sleeping.store(true);
+        if (!_inbox.empty()) {
+            timeout = {};
+        }
+    }
+    auto num = Epoll::get().wait(_events.data(), (int)_events.size(), timeout);
+    _sleeping.store(false, std::memory_order_relaxed);
+    return num;
+}
+
+void EventLoop::set_busy_poll(std::chrono::microseconds budget) noexcept {
+    _busy_poll = budget;
+    _idle_gap = std::chrono::nanoseconds(0);
+}
+
+void EventLoop::set_max_callbacks(size_t limit) noexcept {
+    _max_callbacks = limit;
+}
+
+/// a full batch means more events are pending, so the buffer doubles at
+/// once; it only halves after a long run of batches using under a quarter
+/// of it, which keeps bursty loads from resizing back and forth
+void EventLoop::_resize_events(int num) noexcept {
+    static constexpr uint32_t SHRINK_AFTER = 256;
+    auto size = _events.size();
+    if ((size_t)num == size) {
+        _events_idle = 0;
+        if (size < MAX_EVENTS_NUM) {
+            _events.resize(std::min<size_t>(size * 2, MAX_EVENTS_NUM));
+        }
+    } else if ((size_t)num < size / 4 && size > MIN_EVENTS_NUM) {
+        if (++_events_idle == SHRINK_AFTER) {
+            _events_idle = 0;
+            _events.resize(std::max<size_t>(size / 2, MIN_EVENTS_NUM));
+            _events.shrink_to_fit();
         }
-        std::make_heap(schedule.begin(), schedule.end(), Timer::Compare());
-        _schedule.swap(schedule);
-        Timer::_canceled_count = 0;
     } else {
-        while (!_schedule.empty() && _schedule.front()->canceled()) {
-            std::pop_heap(_schedule.begin(), _schedule.end(), Timer::Compare());
-            _schedule.pop_back();
-            Timer::_canceled_count -= 1;
+        _events_idle = 0;
+    }
+}
+
+FlushNode::~FlushNode() noexcept {
+    if (_queued) {
+        EventLoop::get()._cancel_flush(*this);
+    }
+}
+
+void EventLoop::call_before_poll(FlushNode& node) noexcept {
+    if (!node._queued) {
+        node._queued = true;
+        _flushes.push_back(&node);
+    }
+}
+
+void EventLoop::_cancel_flush(FlushNode& node) noexcept {
+    std::ranges::replace(_flushes, &node, nullptr);
+    node._queued = false;
+}
+
+/// nodes queued by a flush are flushed in the same pass
+void EventLoop::_run_flushes() noexcept {
+    for (size_t i = 0; i < _flushes.size(); ++i) {
+        if (auto node = _flushes[i]) {
+            node->_queued = false;
+            node->flush();
         }
     }
+    _flushes.clear();
+}
 
-    int timeout = -1;
-    if (!_ready.empty() || _stop) {
-        timeout = 0;
-    } else if (!_schedule.empty()) {
-        timeout = duration_cast<std::chrono::milliseconds>(
-            _schedule[0]->_when - _time()
-        ).count();
-        if (timeout > MAX_SELECT_TIMEOUT) {
-            timeout = MAX_SELECT_TIMEOUT;
-        } else if (timeout < 0) {
-            timeout = 0;
+/// process events of epoll
+void EventLoop::_process_epoll(std::chrono::nanoseconds timeout) noexcept {
+    auto& epoll = Epoll::get();
+    if (!_flushes.empty()) {
+        _run_flushes();
+    }
+#if ASYNCIO_IO_URING
+    auto& ring = IoUring::get();
+    ring.submit();
+    if (ring.has_completions()) {
+        timeout = {};
+    }
+#endif
+    auto num = _poll(timeout);
+    // a signal handler interrupting the wait is an empty batch
+    if (num < 0) {
+        if (errno != EINTR) {
+            utils::abort("failed to wait epoll: {}", strerror(errno));
+        }
+        num = 0;
+    }
+    _stats.polls++;
+    _stats.events += num;
+    _stats.max_events = std::max(_stats.max_events, (size_t)num);
+    for (int i = 0; i < num; i++) {
+        auto fd = epoll.from(_events[i]);
+        if (fd == -1) {
+            continue;
+        }
+        auto bits = _events[i].events;
+        if (bits & (EPOLLERR | EPOLLHUP)) {
+            bits |= EPOLLIN | EPOLLOUT;
+        } else if (bits & EPOLLRDHUP) {
+            bits |= EPOLLIN;
+        }
+        epoll.mark_ready(fd, bits);
+        auto& callbacks = epoll.callbacks(fd);
+        if ((bits & EPOLLIN) && callbacks.reader.has_value()) {
+            _call_soon(callbacks.reader->id, std::move(callbacks.reader->cb));
+            callbacks.reader.reset();
+        }
+        if ((bits & EPOLLOUT) && callbacks.writer.has_value()) {
+            _call_soon(callbacks.writer->id, std::move(callbacks.writer->cb));
+            callbacks.writer.reset();
         }
     }
+    _resize_events(num);
+#if ASYNCIO_IO_URING
+    ring.reap();
+#endif
+}
+
+/// run once loop
+void EventLoop::_run_once() noexcept {
+    _inbox.consume([this](EventLoopHandle&& handle) {
+        _call_soon(handle.id, std::move(handle.cb));
+    });
+
+    auto next_when = _schedule->next_when();
+    // negative blocks until an event arrives
+    std::chrono::nanoseconds timeout { -1 };
+    if (!_ready.empty() || _stop) {
+        timeout = {};
+    } else if (next_when) {
+        timeout = std::clamp<std::chrono::nanoseconds>(
+            *next_when - _time(),
+            std::chrono::nanoseconds(0),
+            std::chrono::milliseconds(MAX_SELECT_TIMEOUT)
+        );
+    }
+    auto poll_start = _time();
     _process_epoll(timeout);
+    auto now = _time();
+    _stats.iterations++;
+    _stats.blocked += now - poll_start;
 
-    auto end_time = _time() + clock_resolution;
-    while (!_schedule.empty()) {
-        if (_schedule[0]->_when > end_time) {
-            break;
-        }
-        _ready.push({ _schedule[0]->id(), [t = _schedule[0]] { t->run(); } });
-        std::pop_heap(_schedule.begin(), _schedule.end(), Timer::Compare());
-        _schedule.pop_back();
+    _schedule->pop_expired(now + clock_resolution, _expired);
+    for (auto node : _expired) {
+        auto lag = std::max<std::chrono::nanoseconds>(now - node->when(), {});
+        _stats.lag_total += lag;
+        _stats.lag_max = std::max(_stats.lag_max, lag);
+        node->expire();
     }
+    _stats.timers_fired += _expired.size();
+    _expired.clear();
 
-    std::vector<Handle::ID> canceled {};
     if (!_stop && !_ready.empty()) {
         auto size = _ready.size();
-        for (size_t i = 0; !_stop && i < size; ++i) {
-            if (auto id = _ready.front().id; id == 0 || !Handle::canceled(id)) {
-                _ready.front().cb();
-            } else if (Handle::canceled(id)) {
-                canceled.push_back(id);
+        _stats.ready_high_water = std::max(_stats.ready_high_water, size);
+        if (_max_callbacks != 0) {
+            size = std::min(size, _max_callbacks);
+        }
+        if (_slow_callback.count() != 0) [[unlikely]] {
+            _run_ready_timed(size);
+        } else {
+            for (size_t i = 0; !_stop && i < size; ++i) {
+                auto item = _ready.take();
+                if (item.handle) [[likely]] {
+                    if (!Handle::canceled(item.id)) {
+                        item.handle->coroutine().resume();
+                        _stats.callbacks++;
+                    }
+                } else if (auto handle = _callbacks.take(); !Handle::canceled(handle.id)) {
+                    handle.cb();
+                    _stats.callbacks++;
+                }
             }
-            _ready.pop();
         }
     }
-    for (auto id : canceled) {
-        Handle::_canceled_handles.erase(id);
+    _stats.running += _time() - now;
+}
+
+/// debug flavour of the ready queue run, the task is looked up before the
+/// resume since it may be gone once the coroutine finishes
+void EventLoop::_run_ready_timed(size_t size) noexcept {
+    for (size_t i = 0; !_stop && i < size; ++i) {
+        auto item = _ready.take();
+        std::chrono::nanoseconds duration;
+        if (item.handle) {
+            if (Handle::canceled(item.id)) {
+                continue;
+            }
+            auto loc = item.handle->get_loc();
+            auto start = _time();
+            item.handle->coroutine().resume();
+            duration = _time() - start;
+            _stats.callbacks++;
+            if (duration < _slow_callback) {
+                continue;
+            }
+            SPDLOG_WARN(
+                "executing task {} at {}:{} took {:.3f}ms",
+                loc.function_name(),
+                loc.file_name(),
+                loc.line(),
+                duration.count() / 1e6
+            );
+            if (!Handle::canceled(item.id)) {
+                item.handle->traceback(0);
+            }
+        } else {
+            auto handle = _callbacks.take();
+            if (Handle::canceled(handle.id)) {
+                continue;
+            }
+            auto start = _time();
+            handle.cb();
+            duration = _time() - start;
+            _stats.callbacks++;
+            if (duration < _slow_callback) {
+                continue;
+            }
+            SPDLOG_WARN("executing callback of handle {} took {:.3f}ms", handle.id, duration.count() / 1e6);
+        }
+        _stats.slow_callbacks++;
     }
 }
 
@@ -135,39 +385,61 @@ void EventLoop::_cleanup() noexcept {
         close(eventfd);
         SPDLOG_INFO("close eventfd {}", eventfd);
     }
-    while (!_ready.empty()) {
-        _ready.pop();
-    }
-    Handle::_canceled_handles.clear();
+    _ready.clear();
+    _callbacks.clear();
+    _inbox.clear();
+    _schedule->clear();
     Epoll::get().clear();
 }
 
 void EventLoop::call_soon(EventLoopCallback&& callback) noexcept {
-    _ready.push({ 0, std::move(callback) });
+    _call_soon(0, std::move(callback));
 }
 
 void EventLoop::call_soon(Handle& handle) noexcept {
-    _ready.push({ handle.id(), [h = &handle] { h->run(); } });
+    _call_soon(handle.id(), [h = &handle] { h->run(); });
+}
+
+void EventLoop::call_soon(CoroHandle& handle) noexcept {
+    _ready.push({ &handle, handle.id() });
+}
+
+/// slow path of the ready queue for generic callbacks
+void EventLoop::_call_soon(Handle::ID id, EventLoopCallback&& callback) noexcept {
+    _callbacks.push({ id, std::move(callback) });
+    _ready.push({});
 }
 
 void EventLoop::call_soon_threadsafe(EventLoopCallback&& callback) noexcept {
-    std::lock_guard<std::mutex> lock { _mtx };
-    _ready.push({ 0, std::move(callback) });
+    _inbox.push({ 0, std::move(callback) });
+    _wakeup();
 }
 
 void EventLoop::call_soon_threadsafe(Handle& handle) noexcept {
-    std::lock_guard<std::mutex> lock { _mtx };
-    _ready.push({ handle.id(), [h = &handle] { h->run(); } });
+    _inbox.push({ handle.id(), [h = &handle] { h->run(); } });
+    _wakeup();
 }
 
 std::shared_ptr<Timer> EventLoop::call_at(TimePoint when, EventLoopCallback&& callback) noexcept {
     auto timer = std::make_shared<Timer>(when, std::move(callback));
-    _schedule.push_back(timer);
-    std::push_heap(_schedule.begin(), _schedule.end(), Timer::Compare());
+    timer->_keepalive = timer;
+    _schedule->push(*timer);
+    _stats.timers_scheduled++;
     return timer;
 }
 
-std::shared_ptr<Timer> EventLoop::call_later(std::chrono::milliseconds delay, EventLoopCallback&& callback) noexcept {
+void EventLoop::call_at(TimePoint when, TimerNode& node) noexcept {
+    node.unschedule();
+    node._when = when;
+    _schedule->push(node);
+    _stats.timers_scheduled++;
+}
+
+void EventLoop::call_later(std::chrono::nanoseconds delay, TimerNode& node) noexcept {
+    call_at(Clock::now() + delay, node);
+}
+
+std::shared_ptr<Timer> EventLoop::call_later(std::chrono::nanoseconds delay, EventLoopCallback&& callback) noexcept {
     auto now = Clock::now();
     auto when = now + delay;
     return call_at(when, std::move(callback));
@@ -178,8 +450,47 @@ void EventLoop::stop() noexcept {
     SPDLOG_INFO("event loop stop");
 }
 
+void EventLoop::set_slow_callback_duration(std::chrono::nanoseconds threshold) noexcept {
+    _slow_callback = threshold;
+}
+
+EventLoop::Stats EventLoop::stats() const noexcept {
+    auto stats = _stats;
+    stats.timers_canceled = _schedule->dropped();
+    stats.timer_compactions = _schedule->compactions();
+    return stats;
+}
+
+void EventLoop::set_stats_callback(std::chrono::nanoseconds interval, StatsCallback&& callback) noexcept {
+    _stats_timer.unschedule();
+    _stats_timer.interval = interval;
+    _stats_timer.callback = std::move(callback);
+    if (_stats_timer.callback && interval.count() > 0) {
+        call_later(interval, _stats_timer);
+    }
+}
+
+/// report a snapshot, then start the next period
+void EventLoop::StatsTimer::expire() noexcept {
+    auto& loop = EventLoop::get();
+    callback(loop.stats());
+    loop._stats.ready_high_water = 0;
+    loop._stats.max_events = 0;
+    loop._stats.lag_max = {};
+    loop.call_later(interval, *this);
+}
+
 /// run the event loop
 void EventLoop::run() noexcept {
+    _init_interrupt();
+    _init_thread_eventfd();
+    // the schedule is cleared when the loop stops
+    if (_stats_timer.callback && _stats_timer.interval.count() > 0 && !_stats_timer.scheduled()) {
+        call_later(_stats_timer.interval, _stats_timer);
+    }
+#if ASYNCIO_IO_URING
+    _watch_io_uring();
+#endif
     while (!_stop) {
         _run_once();
     }
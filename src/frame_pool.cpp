@@ -0,0 +1,57 @@
+#include <algorithm>
+
+#include "asyncio/frame_pool.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+FramePool& FramePool::get() noexcept {
+    static thread_local FramePool pool;
+    return pool;
+}
+
+FramePool::~FramePool() noexcept {
+    clear();
+}
+
+void* FramePool::_allocate(size_t size) {
+    _stats.misses++;
+    return ::operator new(_block_size(size));
+}
+
+void FramePool::_deallocate(void* ptr, size_t size) noexcept {
+    ::operator delete(ptr, _block_size(size));
+}
+
+void FramePool::prewarm(size_t size, size_t count) noexcept {
+    if (size == 0 || size > FRAME_POOL_MAX_SIZE) {
+        return;
+    }
+    auto& list = _lists[_class_of(size)];
+    count = std::min<size_t>(count, FRAME_POOL_CACHE);
+    while (list.size < count) {
+        list.head = new (::operator new(_block_size(size))) Block { list.head };
+        list.size++;
+    }
+}
+
+FramePool::Stats FramePool::stats() const noexcept {
+    auto stats = _stats;
+    for (auto& list : _lists) {
+        stats.cached += list.size;
+    }
+    return stats;
+}
+
+void FramePool::clear() noexcept {
+    for (size_t i = 0; i < CLASSES; ++i) {
+        auto& list = _lists[i];
+        while (auto block = list.head) {
+            list.head = block->next;
+            ::operator delete(block, (i + 1) * GRANULARITY);
+        }
+        list.size = 0;
+    }
+}
+
+ASYNCIO_NS_END
@@ -8,15 +8,27 @@
 
  ASYNCIO_NS_BEGIN()
 
-std::unordered_set<Handle::ID> Handle::_canceled_handles {};
+thread_local std::vector<uint32_t> Handle::_generations { 0 };
+thread_local std::vector<uint32_t> Handle::_free_slots {};
 
-bool Handle::canceled(ID id) noexcept {
-    return _canceled_handles.contains(id);
+Handle::ID Handle::new_id() noexcept {
+    uint32_t index;
+    if (!_free_slots.empty()) {
+        index = _free_slots.back();
+        _free_slots.pop_back();
+    } else {
+        index = _generations.size();
+        _generations.push_back(1);
+    }
+    return ((ID)_generations[index] << 32) | index;
 }
 
-Handle::ID Handle::new_id() noexcept {
-    static ID id = 0;
-    return ++id;
+void Handle::_release(ID id, bool canceled) noexcept {
+    auto index = (uint32_t)id;
+    if (!canceled) {
+        _generations[index] += 1;
+    }
+    _free_slots.push_back(index);
 }
 
 Handle::Handle() noexcept: _id(new_id()), _canceled(false) {
@@ -28,12 +40,15 @@ Handle::Handle(Handle&& h) noexcept:
     _canceled(std::exchange(h._canceled, true)) {}
 
 Handle::~Handle() noexcept {
-    if (_canceled) {
-        _canceled_handles.erase(_id);
+    if (_id) {
+        _release(_id, _canceled);
     }
 }
 
 Handle& Handle::operator=(Handle&& h) noexcept {
+    if (_id) {
+        _release(_id, _canceled);
+    }
     _id = std::exchange(h._id, 0);
     _canceled = std::exchange(h._canceled, true);
     return *this;
@@ -48,7 +63,7 @@ void Handle::cancel() noexcept {
         return;
     }
     _canceled = true;
-    _canceled_handles.insert(_id);
+    _generations[(uint32_t)_id] += 1;
 }
 
 ASYNCIO_NS_END
@@ -0,0 +1,415 @@
+#include "asyncio_config.hpp"
+#if ASYNCIO_IO_URING
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+#include <spdlog/spdlog.h>
+
+#include "asyncio/io_uring.hpp"
+#include "asyncio/event_loop.hpp"
+#include "asyncio/utils.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// `user_data` of cancel requests, their completions are ignored
+static constexpr uint64_t CANCEL_DATA = -1;
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) noexcept {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) noexcept {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+IoUring::IoUring() noexcept {
+    io_uring_params params {};
+    params.flags = IORING_SETUP_CLAMP;
+    _fd = io_uring_setup(IO_URING_ENTRIES, &params);
+    if (_fd < 0) {
+        utils::abort("failed to setup io_uring: {}", strerror(errno));
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        utils::abort("io_uring without IORING_FEAT_SINGLE_MMAP is not supported");
+    }
+    _ring_size = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)
+    );
+    _ring = mmap(
+        nullptr, _ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING
+    );
+    auto sqes = mmap(
+        nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES
+    );
+    if (_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        utils::abort("failed to map io_uring: {}", strerror(errno));
+    }
+    auto ring = (char*)_ring;
+    _sqes = (io_uring_sqe*)sqes;
+    _sq_head = (uint32_t*)(ring + params.sq_off.head);
+    _sq_tail = (uint32_t*)(ring + params.sq_off.tail);
+    _sq_mask = *(uint32_t*)(ring + params.sq_off.ring_mask);
+    _sq_entries = params.sq_entries;
+    _cq_head = (uint32_t*)(ring + params.cq_off.head);
+    _cq_tail = (uint32_t*)(ring + params.cq_off.tail);
+    _cq_mask = *(uint32_t*)(ring + params.cq_off.ring_mask);
+    _cqes = (io_uring_cqe*)(ring + params.cq_off.cqes);
+    // sqe slots are used in ring order, so the index array is the identity
+    auto array = (uint32_t*)(ring + params.sq_off.array);
+    for (uint32_t i = 0; i < _sq_entries; ++i) {
+        array[i] = i;
+    }
+    _register_buffers();
+    SPDLOG_INFO("successfully create io_uring fd {} with {} entries", _fd, _sq_entries);
+}
+
+IoUring::~IoUring() noexcept {
+    if (auto fd = std::exchange(_fd, -1); fd != -1) {
+        close(fd);
+        munmap(_sqes, _sq_entries * sizeof(io_uring_sqe));
+        munmap(_ring, _ring_size);
+        SPDLOG_INFO("close io_uring fd {}", fd);
+    }
+    if (_buffers) {
+        munmap(std::exchange(_buffers, nullptr), (size_t)IO_URING_BUFFER_NUM * IO_URING_BUFFER_SIZE);
+    }
+}
+
+IoUring& IoUring::get() noexcept {
+    static thread_local IoUring ring;
+    return ring;
+}
+
+/// registering pins the pages, it may fail under a low RLIMIT_MEMLOCK and
+/// io then falls back to the plain ops
+void IoUring::_register_buffers() noexcept {
+    if constexpr (IO_URING_BUFFER_NUM == 0) {
+        return;
+    }
+    auto total = (size_t)IO_URING_BUFFER_NUM * IO_URING_BUFFER_SIZE;
+    auto buffers = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        SPDLOG_WARN("failed to allocate io_uring buffers: {}", strerror(errno));
+        return;
+    }
+    std::vector<iovec> iovecs(IO_URING_BUFFER_NUM);
+    for (size_t i = 0; i < iovecs.size(); ++i) {
+        iovecs[i] = { (char*)buffers + i * IO_URING_BUFFER_SIZE, IO_URING_BUFFER_SIZE };
+    }
+    if (io_uring_register(_fd, IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) < 0) {
+        SPDLOG_WARN("failed to register io_uring buffers: {}", strerror(errno));
+        munmap(buffers, total);
+        return;
+    }
+    _buffers = (char*)buffers;
+    for (auto i = IO_URING_BUFFER_NUM; i > 0; --i) {
+        _free_buffers.push_back(i - 1);
+    }
+}
+
+int IoUring::_buffer_index(const void* buffer, size_t size) const noexcept {
+    auto p = (const char*)buffer;
+    if (!_buffers || p < _buffers || p + size > _buffers + (size_t)IO_URING_BUFFER_NUM * IO_URING_BUFFER_SIZE) {
+        return -1;
+    }
+    int index = (p - _buffers) / IO_URING_BUFFER_SIZE;
+    if (p + size > _buffers + (index + 1) * IO_URING_BUFFER_SIZE) {
+        return -1;
+    }
+    return index;
+}
+
+std::span<char> IoUring::acquire_buffer() noexcept {
+    if (_free_buffers.empty()) {
+        return {};
+    }
+    auto index = _free_buffers.back();
+    _free_buffers.pop_back();
+    return { _buffers + index * IO_URING_BUFFER_SIZE, IO_URING_BUFFER_SIZE };
+}
+
+void IoUring::release_buffer(std::span<char> buffer) noexcept {
+    auto index = _buffer_index(buffer.data(), buffer.size());
+    if (index == -1) {
+        utils::abort("release buffer not acquired from io_uring");
+    }
+    _free_buffers.push_back(index);
+}
+
+/// the sq tail is published in `submit`, the kernel only reads sqes there
+io_uring_sqe* IoUring::_get_sqe() noexcept {
+    auto tail = *_sq_tail + _to_submit;
+    if (tail - std::atomic_ref(*_sq_head).load(std::memory_order_acquire) == _sq_entries) {
+        submit();
+        tail = *_sq_tail + _to_submit;
+        if (tail - std::atomic_ref(*_sq_head).load(std::memory_order_acquire) == _sq_entries) {
+            utils::abort("io_uring submission queue overflow");
+        }
+    }
+    auto sqe = &_sqes[tail & _sq_mask];
+    *sqe = {};
+    ++_to_submit;
+    return sqe;
+}
+
+IoUring::OpID IoUring::_new_op(CoroHandle* handle, Kind kind, Completion* completion) noexcept {
+    OpID op;
+    if (!_free_ops.empty()) {
+        op = _free_ops.back();
+        _free_ops.pop_back();
+    } else {
+        op = _ops.size();
+        _ops.emplace_back();
+    }
+    _ops[op] = { handle ? handle->id() : 0, handle, completion, 0, -1, kind, true };
+    return op;
+}
+
+void IoUring::submit() noexcept {
+    if (_to_submit) {
+        std::atomic_ref(*_sq_tail).store(*_sq_tail + std::exchange(_to_submit, 0), std::memory_order_release);
+    }
+    while (auto n = *_sq_tail - std::atomic_ref(*_sq_head).load(std::memory_order_acquire)) {
+        if (io_uring_enter(_fd, n, 0, 0) >= 0) {
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        } else if (errno == EBUSY || errno == EAGAIN) {
+            // completion queue overflowed, drain it before submitting more
+            reap();
+            io_uring_enter(_fd, 0, 0, IORING_ENTER_GETEVENTS);
+            reap();
+        } else {
+            utils::abort("failed to submit io_uring: {}", strerror(errno));
+        }
+    }
+}
+
+bool IoUring::has_completions() const noexcept {
+    return *_cq_head != std::atomic_ref(*_cq_tail).load(std::memory_order_acquire);
+}
+
+/// each cqe is consumed before it is dispatched, a completion that submits
+/// may reap again from `submit` and must not see it twice
+void IoUring::reap() noexcept {
+    auto tail = std::atomic_ref(*_cq_tail).load(std::memory_order_acquire);
+    for (auto head = *_cq_head; (int32_t)(tail - head) > 0; head = *_cq_head) {
+        auto cqe = _cqes[head & _cq_mask];
+        std::atomic_ref(*_cq_head).store(head + 1, std::memory_order_release);
+        _complete(cqe.user_data, cqe.res, cqe.flags);
+    }
+}
+
+void IoUring::_complete(uint64_t user_data, int res, uint32_t flags) noexcept {
+    if (user_data == CANCEL_DATA) {
+        return;
+    }
+    auto id = (OpID)user_data;
+    auto& op = _ops[id];
+    switch (op.kind) {
+        case Kind::Single: {
+            op.res = res;
+            op.pending = false;
+            if (Handle::canceled(op.id)) {
+                break;
+            }
+            // may submit new ops, `op` is not touched afterwards
+            if (op.completion) {
+                op.completion->complete(id);
+            } else {
+                EventLoop::get().call_soon(*op.handle);
+            }
+            break;
+        }
+        case Kind::Accept: {
+            auto& acceptor = _acceptors[op.fd];
+            if (res >= 0) {
+                acceptor.conns.push(std::move(res));
+            } else {
+                acceptor.error = -res;
+            }
+            if (!(flags & IORING_CQE_F_MORE)) {
+                acceptor.op = NO_OP;
+                _free_ops.push_back(id);
+            }
+            if (auto waiter = std::exchange(acceptor.waiter, nullptr); waiter && !Handle::canceled(acceptor.id)) {
+                EventLoop::get().call_soon(*waiter);
+            }
+            break;
+        }
+        case Kind::Orphan: {
+            if (op.fd != -1 && res >= 0) {
+                close(res);
+            }
+            if (!(flags & IORING_CQE_F_MORE)) {
+                op.pending = false;
+                _free_ops.push_back(id);
+            }
+            break;
+        }
+    }
+}
+
+void IoUring::_cancel(OpID op) noexcept {
+    auto sqe = _get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = op;
+    sqe->user_data = CANCEL_DATA;
+}
+
+IoUring::OpID IoUring::recv(int fd, char* buffer, size_t size, CoroHandle& handle) noexcept {
+    auto op = _new_op(&handle, Kind::Single);
+    auto sqe = _get_sqe();
+    if (auto index = _buffer_index(buffer, size); index != -1) {
+        // sockets reject a non-zero position
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = index;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)buffer;
+    sqe->len = size;
+    sqe->user_data = op;
+    return op;
+}
+
+IoUring::OpID IoUring::send(int fd, const char* buffer, size_t size, CoroHandle& handle, Completion* completion) noexcept {
+    auto op = _new_op(&handle, Kind::Single, completion);
+    auto sqe = _get_sqe();
+    // no WRITE_FIXED for registered buffers, it can not pass MSG_NOSIGNAL
+    sqe->opcode = IORING_OP_SEND;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)buffer;
+    sqe->len = size;
+    sqe->user_data = op;
+    return op;
+}
+
+IoUring::OpID IoUring::sendmsg(int fd, const msghdr* msg, CoroHandle& handle, Completion* completion) noexcept {
+    auto op = _new_op(&handle, Kind::Single, completion);
+    auto sqe = _get_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)msg;
+    sqe->len = 1;
+    sqe->user_data = op;
+    return op;
+}
+
+IoUring::OpID IoUring::connect(int fd, const sockaddr* addr, socklen_t len, CoroHandle& handle) noexcept {
+    auto op = _new_op(&handle, Kind::Single);
+    auto sqe = _get_sqe();
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)addr;
+    sqe->off = len;
+    sqe->user_data = op;
+    return op;
+}
+
+int IoUring::result(OpID op) noexcept {
+    assert(!_ops[op].pending);
+    auto res = _ops[op].res;
+    _free_ops.push_back(op);
+    return res;
+}
+
+/// the buffer and msghdr of an op live in the awaiter, which is gone once
+/// it drops the op and its frame may be handed out again at once. so the
+/// cancel is submitted right away and the op is waited for until the kernel
+/// is done with it, a socket op completes promptly once canceled
+void IoUring::drop(OpID op) noexcept {
+    if (!_ops[op].pending) {
+        _free_ops.push_back(op);
+        return;
+    }
+    _ops[op].kind = Kind::Orphan;
+    _cancel(op);
+    submit();
+    while (_ops[op].pending) {
+        if (io_uring_enter(_fd, 0, 1, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR) {
+            utils::abort("failed to wait io_uring: {}", strerror(errno));
+        }
+        reap();
+    }
+}
+
+/// one multishot accept keeps delivering connections until it fails
+void IoUring::_arm_accept(int fd, Acceptor& acceptor) noexcept {
+    acceptor.op = _new_op(nullptr, Kind::Accept);
+    _ops[acceptor.op].fd = fd;
+    auto sqe = _get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = acceptor.op;
+}
+
+int IoUring::accepted(int fd) noexcept {
+    auto& acceptor = _acceptors[fd];
+    if (!acceptor.conns.empty()) {
+        return acceptor.conns.take();
+    }
+    if (acceptor.error) {
+        errno = std::exchange(acceptor.error, 0);
+        return -1;
+    }
+    if (acceptor.op == NO_OP) {
+        _arm_accept(fd, acceptor);
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+void IoUring::wait_accept(int fd, CoroHandle& handle) noexcept {
+    auto& acceptor = _acceptors[fd];
+    if (acceptor.waiter) {
+        utils::abort("repeatly accept on fd {}", fd);
+    }
+    acceptor.waiter = &handle;
+    acceptor.id = handle.id();
+}
+
+void IoUring::cancel_accept(int fd, CoroHandle& handle) noexcept {
+    if (auto it = _acceptors.find(fd); it != _acceptors.end() && it->second.waiter == &handle) {
+        it->second.waiter = nullptr;
+    }
+}
+
+void IoUring::clear_fd(int fd) noexcept {
+    auto it = _acceptors.find(fd);
+    if (it == _acceptors.end()) {
+        return;
+    }
+    auto& acceptor = it->second;
+    if (acceptor.op != NO_OP) {
+        _ops[acceptor.op].kind = Kind::Orphan;
+        _cancel(acceptor.op);
+    }
+    while (!acceptor.conns.empty()) {
+        close(acceptor.conns.take());
+    }
+    _acceptors.erase(it);
+}
+
+ASYNCIO_NS_END
+#endif
@@ -0,0 +1,154 @@
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <spdlog/spdlog.h>
+
+#include "asyncio/relay.hpp"
+#include "asyncio/epoll.hpp"
+#include "asyncio/task_group.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// capacity of a default pipe, a splice never moves more at once
+static constexpr size_t RELAY_PIPE_SIZE = 64 * 1024;
+
+
+/// waits for an epoll readiness bit of fd, io_uring builds use it as well
+/// since splice has no completion based counterpart on sockets here
+struct Readiness {
+    int fd;
+    uint32_t event;
+    /// id of the suspended task, 0 once resumed
+    Handle::ID waiter { 0 };
+
+    /// a relay canceled while waiting leaves no callback behind
+    ~Readiness() noexcept {
+        if (waiter == 0) {
+            return;
+        }
+        if (event == EPOLLIN) {
+            Epoll::get().cancel_reader(fd, waiter);
+        } else {
+            Epoll::get().cancel_writer(fd, waiter);
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return Epoll::get().ready(fd) & event;
+    }
+
+    template<typename P>
+    requires concepts::Promise<P> || std::same_as<P, void>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        auto& epoll = Epoll::get();
+        auto resume = [h = &handle.promise()]() {
+            h->run();
+        };
+        waiter = handle.promise().id();
+        if (event == EPOLLIN) {
+            epoll.add_reader(fd, waiter, resume);
+        } else {
+            epoll.add_writer(fd, waiter, resume);
+        }
+    }
+
+    void await_resume() noexcept {
+        waiter = 0;
+    }
+};
+
+
+/// closed with the frame, also when the relay is canceled
+struct Pipe {
+    int fds[2] { -1, -1 };
+
+    Pipe() noexcept {
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+            fds[0] = fds[1] = -1;
+        }
+    }
+    Pipe(Pipe&) = delete;
+    Pipe& operator=(Pipe&) = delete;
+    ~Pipe() noexcept {
+        for (auto fd : fds) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+};
+
+
+/// one direction of a relay, `from` is spliced into the pipe and the pipe
+/// into `to`. reading stops while the pipe is full, so a slow destination
+/// pushes back on the source
+static Task<> pump(int from, int to, size_t& bytes, const char*& error) {
+    Pipe pipe;
+    if (pipe.fds[0] == -1) {
+        error = strerror(errno);
+        co_return;
+    }
+    auto& epoll = Epoll::get();
+    size_t buffered = 0;
+    bool eof = false;
+    const char* failure = nullptr;
+    while (!failure && (!eof || buffered > 0)) {
+        if (!eof && buffered < RELAY_PIPE_SIZE) {
+            auto nbytes = splice(from, nullptr, pipe.fds[1], nullptr, RELAY_PIPE_SIZE - buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (nbytes > 0) {
+                buffered += nbytes;
+            } else if (nbytes == 0) {
+                eof = true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                epoll.clear_ready(from, EPOLLIN);
+                if (buffered == 0) {
+                    co_await Readiness { from, EPOLLIN };
+                    continue;
+                }
+            } else {
+                failure = strerror(errno);
+                break;
+            }
+        }
+        if (buffered > 0) {
+            auto nbytes = splice(pipe.fds[0], nullptr, to, nullptr, buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (nbytes > 0) {
+                buffered -= nbytes;
+                bytes += nbytes;
+            } else if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                epoll.clear_ready(to, EPOLLOUT);
+                co_await Readiness { to, EPOLLOUT };
+            } else if (nbytes == -1 && errno != EINTR) {
+                failure = strerror(errno);
+            }
+        }
+    }
+    if (failure) {
+        SPDLOG_INFO("relay from fd {} to fd {} failed: {}", from, to, failure);
+        if (!error) {
+            error = failure;
+        }
+        // wakes the other direction up, it ends on the shutdown
+        ::shutdown(from, SHUT_RDWR);
+        ::shutdown(to, SHUT_RDWR);
+    } else {
+        ::shutdown(to, SHUT_WR);
+    }
+}
+
+
+Task<RelayStats> relay(Socket& a, Socket& b) noexcept {
+    RelayStats stats;
+    TaskGroup<> group;
+    group.spawn(pump(a.fd(), b.fd(), stats.a_to_b, stats.error));
+    group.spawn(pump(b.fd(), a.fd(), stats.b_to_a, stats.error));
+    co_await group.join();
+    co_return stats;
+}
+
+ASYNCIO_NS_END
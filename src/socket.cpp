@@ -2,6 +2,7 @@
 #include <arpa/inet.h>
 #include <cstring>
 #include <fcntl.h>
+#include <sys/sendfile.h>
 
 #include <spdlog/spdlog.h>
 
@@ -28,16 +29,30 @@ static void nonblock_socket(int fd) noexcept {
 }
 
 
+/// a new fd may reuse the number of one closed without `Socket`, whose
+/// cached registration would keep the new fd out of epoll
+static void forget_fd(int fd) noexcept {
+    Epoll::get().clear_fd(fd);
+#if ASYNCIO_IO_URING
+    IoUring::get().clear_fd(fd);
+#endif
+}
+
+
 ////////////////////////////////////////////////////
 ///ASocket
 ////////////////////////////////////////////////////
 Socket::Socket(): _fd(socket(AF_INET, SOCK_STREAM, 0)), _own_fd(true) {
     SPDLOG_INFO("successfully open socket fd {}", _fd);
     nonblock_socket(_fd);
+    forget_fd(_fd);
 }
 
+/// fds accepted here are already forgotten, others may still carry the
+/// cached registration of a connection closed without `Socket`
 Socket::Socket(int fd): _fd(fd), _own_fd(false) {
     nonblock_socket(fd);
+    Epoll::get().clear_fd(fd);
 }
 
 Socket::Socket(Socket& s):
@@ -61,7 +76,7 @@ Socket::Socket(Socket&& s):
 Socket::~Socket() {
     if (_own_fd) {
         if (auto fd = std::exchange(_fd, -1); fd != -1) {
-            Epoll::get().clear_fd(fd);
+            forget_fd(fd);
             close(fd);
             SPDLOG_INFO("close socket fd {}", fd);
         }
@@ -84,6 +99,19 @@ Socket& Socket::operator=(Socket&& s) noexcept {
     return *this;
 }
 
+/// allow every shard of `run_sharded` to bind the same address,
+/// the kernel then balances incoming connections between them
+int Socket::reuse_port(bool enable) const noexcept {
+    int opt = enable;
+    return setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+}
+
+/// let the kernel poll the device queue for `usecs` on blocking reads,
+/// pairs with `EventLoop::set_busy_poll` for latency sensitive sockets
+int Socket::busy_poll(int usecs) const noexcept {
+    return setsockopt(_fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs));
+}
+
 int Socket::bind(const char* host, short port) noexcept {
     _host = host;
     _port = port;
@@ -111,26 +139,16 @@ Socket::Reader Socket::read(char* buffer, size_t size) const noexcept {
     return { _fd, buffer, size };
 }
 
-Task<void, const char*> Socket::write(const char* buffer, size_t size) const noexcept {
-    int buffer_size = size;
-    int pos = 0;
-    while (true) {
-        auto res = co_await Writer(
-            _fd,
-            buffer + pos,
-            buffer_size
-        );
-        if (!res) {
-            co_return res.error();
-        }
-        auto nbytes = *res;
-        if (nbytes == buffer_size) {
-            break;
-        }
-        buffer_size -= nbytes;
-        pos += nbytes;
-    }
-    co_return nullptr;
+Socket::Writer Socket::write(const char* buffer, size_t size) const noexcept {
+    return { _fd, buffer, size };
+}
+
+Socket::FileSender Socket::sendfile(int file_fd, off_t offset, size_t count) const noexcept {
+    return { _fd, file_fd, offset, count };
+}
+
+Socket::VecWriter Socket::writev(std::span<const iovec> iov) const noexcept {
+    return { _fd, iov };
 }
 
 
@@ -140,7 +158,23 @@ Task<void, const char*> Socket::write(const char* buffer, size_t size) const noe
 Socket::Reader::Reader(int fd, char* buffer, size_t size):
     _fd(fd), _buffer(buffer), _buffer_size(size)
 {
-    _read_once();
+#if !ASYNCIO_IO_URING
+    if (Epoll::get().ready(fd) & EPOLLIN) {
+        _read_once();
+    }
+#endif
+}
+
+Socket::Reader::~Reader() noexcept {
+#if ASYNCIO_IO_URING
+    if (_op != IoUring::NO_OP) {
+        IoUring::get().drop(_op);
+    }
+#else
+    if (_waiter) {
+        Epoll::get().cancel_reader(_fd, _waiter);
+    }
+#endif
 }
 
 void Socket::Reader::_read_once() noexcept {
@@ -152,6 +186,7 @@ void Socket::Reader::_read_once() noexcept {
             if (errno == EINTR) {
                 continue;
             } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                Epoll::get().clear_ready(_fd, EPOLLIN);
                 break;
             }
         } else if (nbytes == 0) {
@@ -163,12 +198,25 @@ void Socket::Reader::_read_once() noexcept {
 }
 
 TaskResult<int, const char*> Socket::Reader::await_resume() noexcept {
-    if (await_ready()) {
+#if ASYNCIO_IO_URING
+    auto res = IoUring::get().result(std::exchange(_op, IoUring::NO_OP));
+    if (res == 0) {
+        SPDLOG_INFO("connection to socket fd {} closed", _fd);
+        _closed = true;
+        return std::unexpected("connection closed");
+    } else if (res < 0) {
+        return std::unexpected(strerror(-res));
+    }
+    _read_size = res;
+    return _read_size;
+#else
+    if (_read_size > 0) {
         return _read_size;
     }
     if (_closed) {
         return std::unexpected("connection closed");
     }
+    _waiter = 0;
     auto& epoll = Epoll::get();
     epoll.remove_reader(_fd);
     _read_once();
@@ -176,6 +224,7 @@ TaskResult<int, const char*> Socket::Reader::await_resume() noexcept {
         return std::unexpected("connection closed");
     }
     return _read_size;
+#endif
 }
 
 ////////////////////////////////////////////////////
@@ -184,7 +233,24 @@ TaskResult<int, const char*> Socket::Reader::await_resume() noexcept {
 Socket::Writer::Writer(int fd, const char* buffer, size_t size):
     _fd(fd), _buffer(buffer), _buffer_size(size)
 {
-    _write_once();
+#if !ASYNCIO_IO_URING
+    if (Epoll::get().ready(fd) & EPOLLOUT) {
+        _write_once();
+    }
+#endif
+}
+
+/// a canceled writer leaves no op nor callback behind, the socket stays usable
+Socket::Writer::~Writer() noexcept {
+#if ASYNCIO_IO_URING
+    if (_op != IoUring::NO_OP) {
+        IoUring::get().drop(_op);
+    }
+#else
+    if (_waiter && !await_ready()) {
+        Epoll::get().cancel_writer(_fd, _waiter->id());
+    }
+#endif
 }
 
 void Socket::Writer::_write_once() noexcept {
@@ -196,30 +262,252 @@ void Socket::Writer::_write_once() noexcept {
             if (errno == EINTR) {
                 continue;
             } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                Epoll::get().clear_ready(_fd, EPOLLOUT);
                 break;
             }
+            _error = strerror(errno);
+            break;
         } else if (nbytes == 0) {
             SPDLOG_INFO("connection to socket fd {} closed", _fd);
-            _closed = true;
+            _error = "connection closed";
             break;
         }
     }
 }
 
-TaskResult<int, const char*> Socket::Writer::await_resume() noexcept {
+#if ASYNCIO_IO_URING
+void Socket::Writer::_submit() noexcept {
+    _op = IoUring::get().send(_fd, _buffer + _write_size, _buffer_size - _write_size, *_waiter, this);
+}
+
+/// a short send, as a fixed buffer write on a full socket may complete,
+/// is resubmitted for the rest instead of resuming the waiter
+void Socket::Writer::complete(IoUring::OpID) noexcept {
+    auto res = IoUring::get().result(std::exchange(_op, IoUring::NO_OP));
+    if (res == 0) {
+        SPDLOG_INFO("connection to socket fd {} closed", _fd);
+        _error = "connection closed";
+    } else if (res < 0) {
+        _error = strerror(-res);
+    } else {
+        _write_size += res;
+    }
     if (await_ready()) {
-        return _write_size;
+        EventLoop::get().call_soon(*_waiter);
+    } else {
+        _submit();
     }
-    if (_closed) {
-        return std::unexpected("connection closed");
+}
+#else
+/// every writable edge sends what it can, the waiter is only resumed once
+/// the buffer is sent or the write failed
+void Socket::Writer::_wait_writable() noexcept {
+    Epoll::get().add_writer(
+        _fd,
+        _waiter->id(),
+        [this]() {
+            _write_once();
+            if (await_ready()) {
+                _waiter->run();
+            } else {
+                _wait_writable();
+            }
+        }
+    );
+}
+#endif
+
+TaskResult<void, const char*> Socket::Writer::await_resume() const noexcept {
+    if (_error) {
+        return std::unexpected(_error);
     }
-    auto& epoll = Epoll::get();
-    epoll.remove_writer(_fd);
-    _write_once();
-    if (_closed) {
-        return std::unexpected("connection closed");
+    return {};
+}
+
+
+////////////////////////////////////////////////////
+///ASocket::VecWriter
+////////////////////////////////////////////////////
+Socket::VecWriter::VecWriter(int fd, std::span<const iovec> iov):
+    _fd(fd), _iov(iov)
+{
+    _advance(0);
+#if !ASYNCIO_IO_URING
+    if (!await_ready() && (Epoll::get().ready(fd) & EPOLLOUT)) {
+        _write_once();
+    }
+#endif
+}
+
+/// a canceled writer leaves no op nor callback behind, the iovecs and the
+/// msghdr may go with the frame
+Socket::VecWriter::~VecWriter() noexcept {
+#if ASYNCIO_IO_URING
+    if (_op != IoUring::NO_OP) {
+        IoUring::get().drop(_op);
     }
-    return _write_size;
+#else
+    if (_waiter && !await_ready()) {
+        Epoll::get().cancel_writer(_fd, _waiter->id());
+    }
+#endif
+}
+
+/// move past `nbytes` more written bytes, empty iovecs are skipped
+void Socket::VecWriter::_advance(size_t nbytes) noexcept {
+    _written += nbytes;
+    _offset += nbytes;
+    while (_index < _iov.size() && _offset >= _iov[_index].iov_len) {
+        _offset -= _iov[_index].iov_len;
+        ++_index;
+    }
+}
+
+/// a partially written iovec is finished by a plain write, the iovecs
+/// themselves are never modified
+void Socket::VecWriter::_write_once() noexcept {
+    while (_index < _iov.size()) {
+        ssize_t nbytes;
+        if (_offset > 0) {
+            auto& iov = _iov[_index];
+            nbytes = ::write(_fd, (const char*)iov.iov_base + _offset, iov.iov_len - _offset);
+        } else {
+            nbytes = ::writev(_fd, &_iov[_index], std::min<size_t>(_iov.size() - _index, IOV_MAX));
+        }
+        if (nbytes > 0) {
+            _advance(nbytes);
+        } else if (nbytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                Epoll::get().clear_ready(_fd, EPOLLOUT);
+                break;
+            }
+            _error = strerror(errno);
+            break;
+        } else {
+            SPDLOG_INFO("connection to socket fd {} closed", _fd);
+            _error = "connection closed";
+            break;
+        }
+    }
+}
+
+#if ASYNCIO_IO_URING
+/// one op per suspension, a short one is resubmitted from its completion
+void Socket::VecWriter::_submit() noexcept {
+    auto& ring = IoUring::get();
+    auto& iov = _iov[_index];
+    if (_offset > 0) {
+        _op = ring.send(_fd, (const char*)iov.iov_base + _offset, iov.iov_len - _offset, *_waiter, this);
+    } else {
+        _msg.msg_iov = const_cast<iovec*>(&iov);
+        _msg.msg_iovlen = std::min<size_t>(_iov.size() - _index, IOV_MAX);
+        _op = ring.sendmsg(_fd, &_msg, *_waiter, this);
+    }
+}
+
+void Socket::VecWriter::complete(IoUring::OpID) noexcept {
+    auto res = IoUring::get().result(std::exchange(_op, IoUring::NO_OP));
+    if (res == 0) {
+        SPDLOG_INFO("connection to socket fd {} closed", _fd);
+        _error = "connection closed";
+    } else if (res < 0) {
+        _error = strerror(-res);
+    } else {
+        _advance(res);
+    }
+    if (await_ready()) {
+        EventLoop::get().call_soon(*_waiter);
+    } else {
+        _submit();
+    }
+}
+#else
+/// every writable edge sends what it can, like `Writer`
+void Socket::VecWriter::_wait_writable() noexcept {
+    Epoll::get().add_writer(
+        _fd,
+        _waiter->id(),
+        [this]() {
+            _write_once();
+            if (await_ready()) {
+                _waiter->run();
+            } else {
+                _wait_writable();
+            }
+        }
+    );
+}
+#endif
+
+TaskResult<size_t, const char*> Socket::VecWriter::await_resume() const noexcept {
+    if (_error) {
+        return std::unexpected(_error);
+    }
+    return _written;
+}
+
+
+////////////////////////////////////////////////////
+///ASocket::FileSender
+////////////////////////////////////////////////////
+Socket::FileSender::FileSender(int fd, int file_fd, off_t offset, size_t count):
+    _fd(fd), _file_fd(file_fd), _offset(offset), _count(count)
+{
+    if (Epoll::get().ready(fd) & EPOLLOUT) {
+        _send_once();
+    }
+}
+
+/// a canceled sender leaves no writer behind, the socket stays usable
+Socket::FileSender::~FileSender() noexcept {
+    if (_waiter && !await_ready()) {
+        Epoll::get().cancel_writer(_fd, _waiter->id());
+    }
+}
+
+void Socket::FileSender::_send_once() noexcept {
+    while (_sent < _count) {
+        auto nbytes = ::sendfile(_fd, _file_fd, &_offset, _count - _sent);
+        if (nbytes > 0) {
+            _sent += nbytes;
+        } else if (nbytes == 0) {
+            _eof = true;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            Epoll::get().clear_ready(_fd, EPOLLOUT);
+            break;
+        } else {
+            _error = strerror(errno);
+            break;
+        }
+    }
+}
+
+/// like `Writer`, the waiter is only resumed once everything is sent
+void Socket::FileSender::_wait_writable() noexcept {
+    Epoll::get().add_writer(
+        _fd,
+        _waiter->id(),
+        [this]() {
+            _send_once();
+            if (await_ready()) {
+                _waiter->run();
+            } else {
+                _wait_writable();
+            }
+        }
+    );
+}
+
+TaskResult<size_t, const char*> Socket::FileSender::await_resume() const noexcept {
+    if (_error) {
+        return std::unexpected(_error);
+    }
+    return _sent;
 }
 
 
@@ -232,19 +520,47 @@ Socket::Accepter::Accepter(int fd, const char* host, short port):
     _accept_once();
 }
 
+Socket::Accepter::~Accepter() noexcept {
+#if ASYNCIO_IO_URING
+    if (_waiter) {
+        IoUring::get().cancel_accept(_fd, *_waiter);
+    }
+#endif
+}
+
+/// with io_uring connections come from the multishot accept of the fd
 void Socket::Accepter::_accept_once() noexcept {
+#if ASYNCIO_IO_URING
+    _conn = IoUring::get().accepted(_fd);
+#else
+    auto& epoll = Epoll::get();
+    if (!(epoll.ready(_fd) & EPOLLIN)) {
+        _conn = -1;
+        return;
+    }
     sockaddr_in addr { 0 };
     init_address(addr, _host, _port);
     socklen_t addr_len = sizeof(addr);
     _conn = ::accept(_fd, (sockaddr*)&addr, &addr_len);
+    if (_conn == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        epoll.clear_ready(_fd, EPOLLIN);
+    }
+#endif
+    if (_conn != -1) {
+        forget_fd(_conn);
+    }
 }
 
 int Socket::Accepter::await_resume() noexcept {
     if (await_ready()) {
         return _conn;
     }
+#if ASYNCIO_IO_URING
+    _waiter = nullptr;
+#else
     auto& epoll = Epoll::get();
     epoll.remove_reader(_fd);
+#endif
     _accept_once();
     return _conn;
 }
@@ -253,12 +569,33 @@ int Socket::Accepter::await_resume() noexcept {
 ///ASocket::Connecter
 ////////////////////////////////////////////////////
 Socket::Connecter::Connecter(int fd, const char* host, short port): _fd(fd) {
+#if ASYNCIO_IO_URING
+    init_address(_addr, host, port);
+    _pending = true;
+#else
     sockaddr_in addr { 0 };
     init_address(addr, host, port);
     _res = ::connect(fd, (sockaddr*)&addr, sizeof(addr));
+    _pending = _res == -1 && errno == EINPROGRESS;
+#endif
+}
+
+Socket::Connecter::~Connecter() noexcept {
+#if ASYNCIO_IO_URING
+    if (_op != IoUring::NO_OP) {
+        IoUring::get().drop(_op);
+    }
+#endif
 }
 
 int Socket::Connecter::await_resume() noexcept {
+#if ASYNCIO_IO_URING
+    if (auto res = IoUring::get().result(std::exchange(_op, IoUring::NO_OP)); res < 0) {
+        errno = -res;
+        return -1;
+    }
+    return 0;
+#else
     if (await_ready()) {
         return _res;
     }
@@ -270,6 +607,97 @@ int Socket::Connecter::await_resume() noexcept {
     } else {
         return 0;
     }
+#endif
+}
+
+
+////////////////////////////////////////////////////
+///Cork
+////////////////////////////////////////////////////
+Cork::Cork(Socket& socket) noexcept: _socket(socket) {}
+
+/// the socket may be closed already, its fd is then cleared
+Cork::~Cork() noexcept {
+    if (_writable_wait) {
+        Epoll::get().cancel_writer(_socket.fd(), 0);
+    }
+}
+
+void Cork::_queue() noexcept {
+    if (!_writable_wait) {
+        EventLoop::get().call_before_poll(*this);
+    }
+}
+
+void Cork::write(const char* buffer, size_t size) noexcept {
+    if (_error) {
+        return;
+    }
+    _buffer.insert(_buffer.end(), buffer, buffer + size);
+    _queue();
+}
+
+void Cork::writev(std::span<const iovec> iov) noexcept {
+    if (_error) {
+        return;
+    }
+    for (auto& v : iov) {
+        _buffer.insert(_buffer.end(), (const char*)v.iov_base, (const char*)v.iov_base + v.iov_len);
+    }
+    _queue();
+}
+
+/// everything buffered goes out in one write, a full socket defers the
+/// rest until epoll reports it writable
+void Cork::flush() noexcept {
+    auto fd = _socket.fd();
+    while (_sent < _buffer.size()) {
+        auto nbytes = ::write(fd, _buffer.data() + _sent, _buffer.size() - _sent);
+        if (nbytes > 0) {
+            _sent += nbytes;
+        } else if (nbytes == -1 && errno == EINTR) {
+            continue;
+        } else if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            auto& epoll = Epoll::get();
+            epoll.clear_ready(fd, EPOLLOUT);
+            if (!_writable_wait) {
+                _writable_wait = true;
+                epoll.add_writer(fd, 0, [this]() {
+                    _writable_wait = false;
+                    flush();
+                });
+            }
+            return;
+        } else {
+            _error = nbytes == 0 ? "connection closed" : strerror(errno);
+            SPDLOG_INFO("corked write to socket fd {} failed: {}", fd, _error);
+            break;
+        }
+    }
+    _buffer.clear();
+    _sent = 0;
+    if (_drainer) {
+        EventLoop::get().call_soon(*std::exchange(_drainer, nullptr));
+    }
+}
+
+Cork::Drainer Cork::drain() noexcept {
+    return { *this };
+}
+
+bool Cork::Drainer::await_ready() const noexcept {
+    if (_cork.pending() > 0 && !_cork._writable_wait) {
+        _cork.flush();
+    }
+    return _cork.pending() == 0 || _cork._error;
+}
+
+TaskResult<void, const char*> Cork::Drainer::await_resume() noexcept {
+    _waiting = false;
+    if (_cork._error) {
+        return std::unexpected(_cork._error);
+    }
+    return {};
 }
 
 ASYNCIO_NS_END
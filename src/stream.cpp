@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstring>
+
+#include "asyncio/stream.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+StreamReader::StreamReader(Socket& socket, size_t size, size_t limit) noexcept:
+    _socket(socket),
+    _buf(std::make_unique<char[]>(std::max<size_t>(size, 1))),
+    _capacity(std::max<size_t>(size, 1)),
+    _limit(std::max(limit, _capacity))
+{
+    //
+}
+
+void StreamReader::_consume() noexcept {
+    _begin += std::exchange(_consumed, 0);
+    if (_begin == _end) {
+        _begin = _end = 0;
+    }
+}
+
+/// make room for `size` more bytes after the buffered ones, false if the
+/// buffer would outgrow its limit
+bool StreamReader::_reserve(size_t size) noexcept {
+    if (_capacity - _end >= size) {
+        return true;
+    }
+    auto data = _end - _begin;
+    if (data + size > _limit) {
+        return false;
+    }
+    if (data + size <= _capacity) {
+        std::memmove(_buf.get(), _buf.get() + _begin, data);
+    } else {
+        auto capacity = _capacity;
+        while (capacity < data + size) {
+            capacity *= 2;
+        }
+        capacity = std::min(capacity, _limit);
+        auto buf = std::make_unique<char[]>(capacity);
+        std::memcpy(buf.get(), _buf.get() + _begin, data);
+        _buf = std::move(buf);
+        _capacity = capacity;
+    }
+    _begin = 0;
+    _end = data;
+    return true;
+}
+
+/// one read into all the free space after the buffered bytes. the tail is
+/// compacted once less than half of the buffer is left, so small messages
+/// still arrive in large batches
+LazyTask<void, const char*> StreamReader::_fill() noexcept {
+    if (_eof) {
+        co_return "connection closed";
+    }
+    if (_capacity - _end < _capacity / 2 && !_reserve(_capacity / 2)) {
+        if (!_reserve(1)) {
+            co_return "buffer limit exceeded";
+        }
+    }
+    auto res = co_await _socket.read(_buf.get() + _end, _capacity - _end);
+    if (!res) {
+        _eof = true;
+        co_return res.error();
+    }
+    _end += *res;
+    co_return nullptr;
+}
+
+std::span<const char> StreamReader::_take(size_t size) noexcept {
+    _consumed = size;
+    return { _buf.get() + _begin, size };
+}
+
+LazyTask<std::span<const char>, const char*> StreamReader::read_some() noexcept {
+    _consume();
+    while (_begin == _end) {
+        if (auto res = co_await _fill(); !res) {
+            co_return std::unexpected(res.error());
+        }
+    }
+    co_return _take(_end - _begin);
+}
+
+LazyTask<std::span<const char>, const char*> StreamReader::read_exactly(size_t size) noexcept {
+    _consume();
+    if (_end - _begin < size && !_reserve(size - (_end - _begin))) {
+        co_return std::unexpected("buffer limit exceeded");
+    }
+    while (_end - _begin < size) {
+        if (auto res = co_await _fill(); !res) {
+            co_return std::unexpected(res.error());
+        }
+    }
+    co_return _take(size);
+}
+
+LazyTask<std::span<const char>, const char*> StreamReader::read_until(std::string_view delim) noexcept {
+    _consume();
+    // bytes already searched are not searched again after a fill
+    size_t searched = 0;
+    while (true) {
+        std::string_view data { _buf.get() + _begin, _end - _begin };
+        if (auto pos = data.find(delim, searched); pos != data.npos) {
+            co_return _take(pos + delim.size());
+        }
+        if (data.size() >= delim.size()) {
+            searched = data.size() - delim.size() + 1;
+        }
+        if (auto res = co_await _fill(); !res) {
+            co_return std::unexpected(res.error());
+        }
+    }
+}
+
+ASYNCIO_NS_END
@@ -2,27 +2,43 @@
 
 #include "asyncio/types.hpp"
 #include "asyncio/timer.hpp"
+#include "asyncio/timer_queue.hpp"
+#include "asyncio/event_loop.hpp"
 
 
 ASYNCIO_NS_BEGIN()
 
 using namespace types;
 
-size_t Timer::_canceled_count = 0;
+TimerNode::~TimerNode() noexcept {
+    unschedule();
+}
+
+void TimerNode::unschedule() noexcept {
+    if (_queue) {
+        _queue->remove(*this);
+    }
+}
+
+void TimerNode::_cancel() noexcept {
+    if (_queue) {
+        _queue->cancel(*this);
+    }
+}
+
 
 Timer::Timer(TimePoint when, EventLoopCallback&& callback):
     Handle(),
-    _when(when),
     _callback(std::move(callback))
 {
+    _when = when;
 }
 
 Timer::Timer(Timer&& timer):
     Handle(std::move(timer)),
-    _when(timer._when),
     _callback(std::exchange(timer._callback, nullptr))
 {
-    //
+    _when = timer._when;
 }
 
 Timer& Timer::operator=(Timer&& timer) noexcept {
@@ -32,12 +48,28 @@ Timer& Timer::operator=(Timer&& timer) noexcept {
 }
 
 void Timer::cancel() noexcept {
-    _canceled_count++;
+    if (canceled()) {
+        Handle::cancel();
+        return;
+    }
     Handle::cancel();
+    if (scheduled()) {
+        // the queue may drop the last reference
+        auto self = _keepalive;
+        _cancel();
+    }
 }
 
 void Timer::run() noexcept {
     _callback();
 }
 
+void Timer::expire() noexcept {
+    EventLoop::get()._call_soon(id(), [t = std::move(_keepalive)] { t->run(); });
+}
+
+void Timer::release() noexcept {
+    _keepalive = nullptr;
+}
+
 ASYNCIO_NS_END
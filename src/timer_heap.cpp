@@ -0,0 +1,137 @@
+#define _MIN_SCHEDULED_TIMER_HANDLES 100
+#define _MIN_CANCELLED_TIMER_HANDLES_FRACTION 0.5
+
+#include "asyncio/timer_queue.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+TimerHeap::~TimerHeap() noexcept {
+    clear();
+}
+
+void TimerHeap::_sift_up(size_t i) noexcept {
+    auto node = _heap[i];
+    while (i > 0) {
+        auto parent = (i - 1) / 2;
+        if (_heap[parent]->_when <= node->_when) {
+            break;
+        }
+        _set(i, _heap[parent]);
+        i = parent;
+    }
+    _set(i, node);
+}
+
+void TimerHeap::_sift_down(size_t i) noexcept {
+    auto node = _heap[i];
+    auto size = _heap.size();
+    while (true) {
+        auto child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && _heap[child + 1]->_when < _heap[child]->_when) {
+            child++;
+        }
+        if (node->_when <= _heap[child]->_when) {
+            break;
+        }
+        _set(i, _heap[child]);
+        i = child;
+    }
+    _set(i, node);
+}
+
+TimerNode* TimerHeap::_erase(size_t i) noexcept {
+    auto node = _heap[i];
+    auto last = _heap.back();
+    _heap.pop_back();
+    if (i < _heap.size()) {
+        _set(i, last);
+        _sift_down(i);
+        _sift_up(last->_index);
+    }
+    if (node->_tombstone) {
+        _canceled_count -= 1;
+    }
+    return node;
+}
+
+void TimerHeap::push(TimerNode& node) noexcept {
+    attach(node);
+    node._tombstone = false;
+    _heap.push_back(&node);
+    _sift_up(_heap.size() - 1);
+}
+
+void TimerHeap::cancel(TimerNode& node) noexcept {
+    if (!node._tombstone) {
+        node._tombstone = true;
+        _canceled_count++;
+        _dropped++;
+    }
+}
+
+void TimerHeap::remove(TimerNode& node) noexcept {
+    if (!node._tombstone) {
+        _dropped++;
+    }
+    detach(*_erase(node._index));
+}
+
+std::optional<TimePoint> TimerHeap::next_when() noexcept {
+    if (
+        _heap.size() > _MIN_SCHEDULED_TIMER_HANDLES
+        && _canceled_count / (double)_heap.size() > _MIN_CANCELLED_TIMER_HANDLES_FRACTION
+    ) {
+        size_t size = 0;
+        for (auto node : _heap) {
+            if (node->_tombstone) {
+                release(*node);
+            } else {
+                _set(size++, node);
+            }
+        }
+        _heap.resize(size);
+        for (auto i = size / 2; i > 0; --i) {
+            _sift_down(i - 1);
+        }
+        _canceled_count = 0;
+        _compactions++;
+    } else {
+        while (!_heap.empty() && _heap.front()->_tombstone) {
+            release(*_erase(0));
+        }
+    }
+    if (_heap.empty()) {
+        return std::nullopt;
+    }
+    return _heap.front()->_when;
+}
+
+void TimerHeap::pop_expired(TimePoint end, std::vector<TimerNode*>& expired) noexcept {
+    while (!_heap.empty()) {
+        if (_heap[0]->_when > end) {
+            break;
+        }
+        auto node = _erase(0);
+        if (node->_tombstone) {
+            release(*node);
+        } else {
+            detach(*node);
+            expired.push_back(node);
+        }
+    }
+}
+
+void TimerHeap::clear() noexcept {
+    auto heap = std::move(_heap);
+    _heap.clear();
+    _canceled_count = 0;
+    for (auto node : heap) {
+        release(*node);
+    }
+}
+
+ASYNCIO_NS_END
@@ -0,0 +1,200 @@
+#include <bit>
+
+#include "asyncio/timer_queue.hpp"
+
+
+ASYNCIO_NS_BEGIN()
+
+/// level of a timer due at `when`, decided by the highest bit that differs
+/// from the current tick
+static size_t level_for(uint64_t elapsed, uint64_t when) noexcept {
+    auto masked = (elapsed ^ when) | (TimerWheel::SLOTS - 1);
+    if (masked >= TimerWheel::MAX_TICKS) {
+        masked = TimerWheel::MAX_TICKS - 1;
+    }
+    auto significant = 63 - std::countl_zero(masked);
+    return significant / TimerWheel::LEVEL_BITS;
+}
+
+static inline uint64_t slot_range(size_t level) noexcept {
+    return (uint64_t)1 << (level * TimerWheel::LEVEL_BITS);
+}
+
+TimerWheel::TimerWheel(std::chrono::nanoseconds tick) noexcept:
+    _origin(Clock::now()),
+    _tick(tick)
+{
+    //
+}
+
+TimerWheel::~TimerWheel() noexcept {
+    clear();
+}
+
+uint64_t TimerWheel::_to_tick(TimePoint when, bool ceil) const noexcept {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when - _origin).count();
+    if (ns <= 0) {
+        return 0;
+    }
+    auto tick = _tick.count();
+    return (ns + (ceil ? tick - 1 : 0)) / tick;
+}
+
+TimerWheel::List& TimerWheel::_list_of(TimerNode& node) noexcept {
+    if (node._level == LEVELS) {
+        return _pending;
+    }
+    return _levels[node._level].slots[node._slot];
+}
+
+void TimerWheel::_insert(TimerNode& node) noexcept {
+    List* list;
+    if (node._tick <= _elapsed) {
+        node._level = LEVELS;
+        list = &_pending;
+    } else {
+        // far timers are parked at the top level and cascaded again later
+        auto when = std::min(node._tick, _elapsed + MAX_TICKS - 1);
+        auto level = level_for(_elapsed, when);
+        auto slot = (when >> (level * LEVEL_BITS)) & (SLOTS - 1);
+        node._level = level;
+        node._slot = slot;
+        _levels[level].occupied |= (uint64_t)1 << slot;
+        list = &_levels[level].slots[slot];
+    }
+    node._prev = list->tail;
+    node._next = nullptr;
+    if (list->tail) {
+        list->tail->_next = &node;
+    } else {
+        list->head = &node;
+    }
+    list->tail = &node;
+}
+
+void TimerWheel::_unlink(TimerNode& node) noexcept {
+    auto& list = _list_of(node);
+    if (node._prev) {
+        node._prev->_next = node._next;
+    } else {
+        list.head = node._next;
+    }
+    if (node._next) {
+        node._next->_prev = node._prev;
+    } else {
+        list.tail = node._prev;
+    }
+    node._prev = node._next = nullptr;
+    if (!list.head && node._level != LEVELS) {
+        _levels[node._level].occupied &= ~((uint64_t)1 << node._slot);
+    }
+}
+
+void TimerWheel::push(TimerNode& node) noexcept {
+    attach(node);
+    node._tick = _to_tick(node._when, true);
+    _insert(node);
+    _size++;
+}
+
+void TimerWheel::cancel(TimerNode& node) noexcept {
+    _unlink(node);
+    _size--;
+    _dropped++;
+    release(node);
+}
+
+void TimerWheel::remove(TimerNode& node) noexcept {
+    _unlink(node);
+    _size--;
+    _dropped++;
+    detach(node);
+}
+
+std::optional<TimerWheel::Expiration> TimerWheel::_next_expiration() const noexcept {
+    for (size_t level = 0; level < LEVELS; ++level) {
+        auto occupied = _levels[level].occupied;
+        if (!occupied) {
+            continue;
+        }
+        auto range = slot_range(level);
+        auto now_slot = _elapsed / range;
+        auto zeros = std::countr_zero(std::rotr(occupied, (int)(now_slot % SLOTS)));
+        auto slot = (zeros + now_slot) % SLOTS;
+        auto level_range = range * SLOTS;
+        auto deadline = (_elapsed & ~(level_range - 1)) + slot * range;
+        if (deadline <= _elapsed) {
+            // only possible at the top level for timers beyond the wheel
+            deadline += level_range;
+        }
+        return Expiration { level, slot, deadline };
+    }
+    return std::nullopt;
+}
+
+std::optional<TimePoint> TimerWheel::next_when() noexcept {
+    if (_pending.head) {
+        return _origin + _tick * (int64_t)_elapsed;
+    }
+    if (auto exp = _next_expiration()) {
+        return _origin + _tick * (int64_t)exp->deadline;
+    }
+    return std::nullopt;
+}
+
+void TimerWheel::pop_expired(TimePoint end, std::vector<TimerNode*>& expired) noexcept {
+    auto take = [this, &expired](TimerNode& node) {
+        detach(node);
+        _size--;
+        expired.push_back(&node);
+    };
+    auto target = _to_tick(end, false);
+    while (auto node = _pending.head) {
+        _unlink(*node);
+        take(*node);
+    }
+    while (auto exp = _next_expiration()) {
+        if (exp->deadline > target) {
+            break;
+        }
+        _elapsed = exp->deadline;
+        auto& list = _levels[exp->level].slots[exp->slot];
+        auto node = std::exchange(list.head, nullptr);
+        list.tail = nullptr;
+        _levels[exp->level].occupied &= ~((uint64_t)1 << exp->slot);
+        while (node) {
+            auto next = node->_next;
+            node->_prev = node->_next = nullptr;
+            if (node->_tick <= _elapsed) {
+                take(*node);
+            } else {
+                _insert(*node);
+            }
+            node = next;
+        }
+    }
+    if (target > _elapsed) {
+        _elapsed = target;
+    }
+}
+
+void TimerWheel::clear() noexcept {
+    auto drop = [this](List& list) {
+        while (auto node = list.head) {
+            list.head = node->_next;
+            node->_prev = node->_next = nullptr;
+            release(*node);
+        }
+        list.tail = nullptr;
+    };
+    for (auto& level : _levels) {
+        for (auto& list : level.slots) {
+            drop(list);
+        }
+        level.occupied = 0;
+    }
+    drop(_pending);
+    _size = 0;
+}
+
+ASYNCIO_NS_END
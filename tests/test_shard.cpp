@@ -0,0 +1,45 @@
+#include <atomic>
+#include <mutex>
+#include <set>
+
+#include <boost/ut.hpp>
+
+#include "asyncio.hpp"
+using namespace kwa;
+using namespace boost::ut;
+using namespace boost::ut::bdd;
+
+
+int main() {
+    "shard"_test = [] {
+        given("one loop per thread") = [] {
+            std::mutex mtx;
+            std::set<asyncio::EventLoop*> loops;
+            std::atomic<int> done { 0 };
+            asyncio::run_sharded(
+                4,
+                [&](size_t) -> asyncio::Task<> {
+                    {
+                        std::lock_guard lock { mtx };
+                        loops.insert(&asyncio::EventLoop::get());
+                    }
+                    co_await asyncio::sleep<10>();
+                    done++;
+                }
+            );
+            expect(loops.size() == 4);
+            expect(done == 4);
+        };
+
+        given("shard result") = [] {
+            auto res = asyncio::run_sharded(
+                3,
+                [](size_t shard) -> asyncio::Task<int> {
+                    co_await asyncio::sleep<0>();
+                    co_return shard * 10;
+                }
+            );
+            expect(res == std::vector<int>{ 0, 10, 20 });
+        };
+    };
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <vector>
+
 #include <boost/ut.hpp>
 
 #include "asyncio.hpp"
@@ -5,6 +8,9 @@ using namespace kwa;
 using namespace boost::ut;
 using namespace boost::ut::bdd;
 
+// the timing wheel rounds deadlines up to its tick
+constexpr int64_t SLACK_US = ASYNCIO_TIMER_WHEEL ? TIMER_WHEEL_TICK_US : 0;
+
 
 int main() {
     "sleep"_test = [] {
@@ -31,7 +37,24 @@ int main() {
                     co_await asyncio::sleep<500>();
                     auto end = asyncio::types::Clock::now();
                     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                    expect(duration > 499 and duration < 501);
+                    expect(duration > 499 and duration < 501 + SLACK_US / 1000);
+                }()
+            );
+        };
+
+        given("delay 100us") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    std::vector<int64_t> durations;
+                    for (int i = 0; i < 21; ++i) {
+                        auto start = asyncio::types::Clock::now();
+                        co_await asyncio::sleep_for(std::chrono::microseconds(100));
+                        auto end = asyncio::types::Clock::now();
+                        durations.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                    }
+                    std::ranges::sort(durations);
+                    expect(durations.front() >= 100);
+                    expect(durations[durations.size() / 2] < 500 + SLACK_US) << durations[durations.size() / 2];
                 }()
             );
         };
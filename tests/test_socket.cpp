@@ -0,0 +1,607 @@
+#include <string>
+
+#include <boost/ut.hpp>
+
+#include "asyncio.hpp"
+using namespace kwa;
+using namespace boost::ut;
+using namespace boost::ut::bdd;
+
+
+static asyncio::Task<> echo(int conn) {
+    asyncio::Socket s { conn };
+    char buf[4096];
+    while (true) {
+        auto res = co_await s.read(buf, sizeof(buf));
+        if (!res) {
+            break;
+        }
+        if (auto w = co_await s.write(buf, *res); !w) {
+            break;
+        }
+    }
+    close(conn);
+}
+
+
+int main() noexcept {
+    "socket"_test = [] {
+        given("echo round trip") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23457) == 0);
+                    expect(server.listen(16) == 0);
+                    auto client = [] -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23457) == 0);
+                        std::string msg(256 * 1024, 'x');
+                        for (size_t i = 0; i < msg.size(); i++) {
+                            msg[i] = 'a' + i % 26;
+                        }
+                        // a plain write only makes progress while awaited
+                        auto w = [](asyncio::Socket& c, std::string& msg) -> asyncio::Task<void, const char*> {
+                            co_return co_await c.write(msg.data(), msg.size());
+                        }(c, msg);
+                        std::string back(msg.size(), '\0');
+                        size_t got = 0;
+                        while (got < msg.size()) {
+                            auto res = co_await c.read(back.data() + got, msg.size() - got);
+                            if (!res) {
+                                break;
+                            }
+                            got += *res;
+                        }
+                        co_await w;
+                        expect(back == msg);
+                    }();
+                    auto conn = co_await server.accept();
+                    expect(conn >= 0);
+                    auto server_task = echo(conn);
+                    co_await client;
+                }()
+            );
+        };
+
+        given("accept several connections") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23458) == 0);
+                    expect(server.listen(16) == 0);
+                    auto connect = [] -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23458) == 0);
+                        char buf[8];
+                        auto res = co_await c.read(buf, sizeof(buf));
+                        expect(!res);
+                    };
+                    auto c1 = connect();
+                    auto c2 = connect();
+                    auto c3 = connect();
+                    for (int i = 0; i < 3; ++i) {
+                        auto conn = co_await server.accept();
+                        expect(conn >= 0);
+                        close(conn);
+                    }
+                    co_await c1;
+                    co_await c2;
+                    co_await c3;
+                }()
+            );
+        };
+
+        given("connect refused") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23459) == -1);
+                }()
+            );
+        };
+
+        given("stream reader") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23461) == 0);
+                    expect(server.listen(16) == 0);
+                    auto client = [] -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23461) == 0);
+                        std::string msg = "hello\nworld\r\n0123456789";
+                        msg += std::string(100, 'x') + "END";
+                        msg += std::string(300, 'y');
+                        expect(!!co_await c.write(msg.data(), msg.size()));
+                    }();
+                    asyncio::Socket conn { co_await server.accept() };
+                    asyncio::StreamReader reader(conn, 16, 256);
+                    auto view = [](auto res) {
+                        return res ? std::string_view(res->data(), res->size()) : std::string_view("<error>");
+                    };
+                    expect(view(co_await reader.read_line()) == "hello\n");
+                    expect(view(co_await reader.read_until("\r\n")) == "world\r\n");
+                    expect(view(co_await reader.read_exactly(10)) == "0123456789");
+                    auto line = co_await reader.read_until("END");
+                    expect(line and line->size() == 103u);
+                    expect(reader.capacity() > 16u) << "the buffer grows for long frames";
+                    auto big = co_await reader.read_exactly(300);
+                    expect(!big) << "frames larger than the limit fail";
+                    size_t rest = 0;
+                    while (rest < 300) {
+                        auto some = co_await reader.read_some();
+                        if (!some) {
+                            break;
+                        }
+                        rest += some->size();
+                    }
+                    expect(rest == 300u);
+                    co_await client;
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("gather write") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23462) == 0);
+                    expect(server.listen(16) == 0);
+                    std::string header = "header:";
+                    std::string body(512 * 1024, 'b');
+                    std::string trailer = ":trailer";
+                    auto client = [](std::string& header, std::string& body, std::string& trailer) -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23462) == 0);
+                        iovec iov[] = {
+                            { header.data(), header.size() },
+                            { nullptr, 0 },
+                            { body.data(), body.size() },
+                            { trailer.data(), trailer.size() },
+                        };
+                        expect(!!co_await c.writev(iov));
+                    }(header, body, trailer);
+                    asyncio::Socket conn { co_await server.accept() };
+                    asyncio::StreamReader reader(conn);
+                    auto res = co_await reader.read_exactly(header.size());
+                    expect(res and std::string_view(res->data(), res->size()) == header);
+                    size_t got = 0;
+                    while (got < body.size()) {
+                        auto some = co_await reader.read_exactly(std::min<size_t>(4096, body.size() - got));
+                        if (!some) {
+                            break;
+                        }
+                        got += some->size();
+                    }
+                    expect(got == body.size());
+                    res = co_await reader.read_exactly(trailer.size());
+                    expect(res and std::string_view(res->data(), res->size()) == trailer);
+                    co_await client;
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("cork") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23463) == 0);
+                    expect(server.listen(16) == 0);
+                    auto client = [] -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23463) == 0);
+                        asyncio::StreamReader reader(c);
+                        for (int i = 0; i < 1000; ++i) {
+                            auto line = co_await reader.read_line();
+                            expect(line and std::string_view(line->data(), line->size()) == std::to_string(i) + "\n");
+                        }
+                    }();
+                    asyncio::Socket conn { co_await server.accept() };
+                    asyncio::Cork cork(conn);
+                    for (int i = 0; i < 1000; ++i) {
+                        auto line = std::to_string(i) + "\n";
+                        cork.write(line.data(), line.size());
+                    }
+                    expect(cork.pending() > 0u) << "nothing is sent before the loop polls";
+                    co_await asyncio::sleep<1>();
+                    expect(cork.pending() == 0u);
+                    expect(!!co_await cork.drain());
+                    co_await client;
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("write fast path") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23464) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23464) == 0);
+                    asyncio::Socket conn { co_await server.accept() };
+                    auto& pool = asyncio::FramePool::get();
+                    auto before = pool.stats();
+                    for (int i = 0; i < 100; ++i) {
+                        expect(!!co_await c.write("ping", 4));
+                    }
+                    auto after = pool.stats();
+                    expect(after.hits == before.hits and after.misses == before.misses) << "a write needs no coroutine frame";
+                    asyncio::StreamReader reader(conn);
+                    auto res = co_await reader.read_exactly(400);
+                    expect(res and std::string_view(res->data(), 4) == "ping");
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("sendfile") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    char path[] = "/tmp/asyncio_sendfile_XXXXXX";
+                    int file = mkstemp(path);
+                    expect(file >= 0);
+                    unlink(path);
+                    std::string data(1024 * 1024, '\0');
+                    for (size_t i = 0; i < data.size(); i++) {
+                        data[i] = 'a' + i % 26;
+                    }
+                    expect(::write(file, data.data(), data.size()) == (ssize_t)data.size());
+
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23465) == 0);
+                    expect(server.listen(16) == 0);
+                    auto client = [](std::string& data) -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23465) == 0);
+                        asyncio::StreamReader reader(c);
+                        size_t got = 0;
+                        bool same = true;
+                        while (true) {
+                            auto some = co_await reader.read_some();
+                            if (!some) {
+                                break;
+                            }
+                            same = same && std::string_view(some->data(), some->size()) == std::string_view(data).substr(10 + got, some->size());
+                            got += some->size();
+                        }
+                        expect(got == data.size() - 10);
+                        expect(same);
+                    }(data);
+                    asyncio::Socket conn { co_await server.accept() };
+                    auto sent = co_await conn.sendfile(file, 10, data.size());
+                    expect(sent and *sent == data.size() - 10) << "stops short at the end of the file";
+                    close(conn.fd());
+                    co_await client;
+                    close(file);
+                }()
+            );
+        };
+
+        given("splice relay") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket upstream;
+                    expect(upstream.reuse_port() == 0);
+                    expect(upstream.bind("127.0.0.1", 23466) == 0);
+                    expect(upstream.listen(16) == 0);
+                    asyncio::Socket proxy;
+                    expect(proxy.reuse_port() == 0);
+                    expect(proxy.bind("127.0.0.1", 23467) == 0);
+                    expect(proxy.listen(16) == 0);
+                    std::string msg(1024 * 1024, '\0');
+                    for (size_t i = 0; i < msg.size(); i++) {
+                        msg[i] = 'a' + i % 26;
+                    }
+                    auto client = [](std::string& msg) -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23467) == 0);
+                        auto w = [](asyncio::Socket& c, std::string& msg) -> asyncio::Task<> {
+                            expect(!!co_await c.write(msg.data(), msg.size()));
+                            // half-close, the echo still flows back
+                            shutdown(c.fd(), SHUT_WR);
+                        }(c, msg);
+                        std::string back;
+                        char buf[4096];
+                        while (true) {
+                            auto res = co_await c.read(buf, sizeof(buf));
+                            if (!res) {
+                                break;
+                            }
+                            back.append(buf, *res);
+                        }
+                        co_await w;
+                        expect(back == msg);
+                    }(msg);
+                    asyncio::Socket front { co_await proxy.accept() };
+                    asyncio::Socket back;
+                    expect(co_await back.connect("127.0.0.1", 23466) == 0);
+                    auto server_task = echo(co_await upstream.accept());
+                    auto stats = co_await asyncio::relay(front, back);
+                    expect(stats.a_to_b == msg.size());
+                    expect(stats.b_to_a == msg.size());
+                    expect(stats.error == nullptr);
+                    co_await client;
+                    close(front.fd());
+                }()
+            );
+        };
+
+        given("cancel a blocked writev") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23469) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23469) == 0);
+                    asyncio::Socket conn { co_await server.accept() };
+                    std::string big(32 * 1024 * 1024, 'x');
+                    {
+                        // the peer does not read yet, the writev blocks on a full socket
+                        auto writer = [](asyncio::Socket& conn, std::string& big) -> asyncio::Task<> {
+                            iovec iov[] = { { big.data(), big.size() } };
+                            co_await conn.writev(iov);
+                            expect(false);
+                        }(conn, big);
+                        co_await asyncio::sleep<5>();
+                        expect(!writer.done());
+                        writer.cancel();
+                    }
+                    auto drain = [](asyncio::Socket& c) -> asyncio::Task<> {
+                        char buf[64 * 1024];
+                        while (co_await c.read(buf, sizeof(buf))) {}
+                    }(c);
+                    iovec iov[] = { { (void*)"end", 3 } };
+                    expect(!!co_await conn.writev(iov)) << "the canceled writev left no writer behind";
+                    shutdown(conn.fd(), SHUT_WR);
+                    co_await drain;
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("cancel a blocked sendfile") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    char path[] = "/tmp/asyncio_sendfile_XXXXXX";
+                    int file = mkstemp(path);
+                    expect(file >= 0);
+                    unlink(path);
+                    expect(ftruncate(file, 32 * 1024 * 1024) == 0);
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23470) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23470) == 0);
+                    asyncio::Socket conn { co_await server.accept() };
+                    {
+                        auto sender = [](asyncio::Socket& conn, int file) -> asyncio::Task<> {
+                            co_await conn.sendfile(file, 0, 32 * 1024 * 1024);
+                            expect(false);
+                        }(conn, file);
+                        co_await asyncio::sleep<5>();
+                        expect(!sender.done());
+                        sender.cancel();
+                    }
+                    auto drain = [](asyncio::Socket& c) -> asyncio::Task<> {
+                        char buf[64 * 1024];
+                        while (co_await c.read(buf, sizeof(buf))) {}
+                    }(c);
+                    expect(!!co_await conn.write("end", 3)) << "the canceled sendfile left no writer behind";
+                    shutdown(conn.fd(), SHUT_WR);
+                    co_await drain;
+                    close(conn.fd());
+                    close(file);
+                }()
+            );
+        };
+
+        given("cancel a pending read") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23468) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23468) == 0);
+                    asyncio::Socket conn { co_await server.accept() };
+                    {
+                        auto reader = [](asyncio::Socket& conn) -> asyncio::Task<> {
+                            char buf[64];
+                            co_await conn.read(buf, sizeof(buf));
+                            expect(false);
+                        }(conn);
+                        co_await asyncio::sleep<1>();
+                        reader.cancel();
+                    }
+                    // the canceled read is gone before its frame is reused
+                    expect(!!co_await c.write("hello", 5));
+                    char buf[64];
+                    auto res = co_await conn.read(buf, sizeof(buf));
+                    expect(res and std::string_view(buf, *res) == "hello");
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("cancel a blocked write") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23471) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23471) == 0);
+                    asyncio::Socket conn { co_await server.accept() };
+                    std::string big(32 * 1024 * 1024, 'x');
+                    {
+                        auto writer = [](asyncio::Socket& conn, std::string& big) -> asyncio::Task<> {
+                            co_await conn.write(big.data(), big.size());
+                            expect(false);
+                        }(conn, big);
+                        co_await asyncio::sleep<5>();
+                        expect(!writer.done());
+                        writer.cancel();
+                    }
+                    auto drain = [](asyncio::Socket& c) -> asyncio::Task<> {
+                        char buf[64 * 1024];
+                        while (co_await c.read(buf, sizeof(buf))) {}
+                    }(c);
+                    expect(!!co_await conn.write("end", 3)) << "the canceled write left no writer behind";
+                    shutdown(conn.fd(), SHUT_WR);
+                    co_await drain;
+                    close(conn.fd());
+                }()
+            );
+        };
+
+        given("cancel an idle relay") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23472) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c1, c2;
+                    expect(co_await c1.connect("127.0.0.1", 23472) == 0);
+                    asyncio::Socket a { co_await server.accept() };
+                    expect(co_await c2.connect("127.0.0.1", 23472) == 0);
+                    asyncio::Socket b { co_await server.accept() };
+                    {
+                        auto relay = asyncio::relay(a, b);
+                        co_await asyncio::sleep<5>();
+                        expect(!relay.done());
+                        relay.cancel();
+                    }
+                    // both sockets can be waited on again once the relay is gone
+                    auto read = [](asyncio::Socket& s, std::string_view expected) -> asyncio::Task<> {
+                        char buf[64];
+                        auto res = co_await s.read(buf, sizeof(buf));
+                        expect(res and std::string_view(buf, *res) == expected);
+                    };
+                    auto ra = read(a, "ping");
+                    auto rb = read(b, "pong");
+                    co_await asyncio::sleep<1>();
+                    expect(!!co_await c1.write("ping", 4));
+                    expect(!!co_await c2.write("pong", 4));
+                    co_await ra;
+                    co_await rb;
+                    close(a.fd());
+                    close(b.fd());
+                }()
+            );
+        };
+
+        given("reuse the number of a closed fd") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    int raw = socket(AF_INET, SOCK_STREAM, 0);
+                    {
+                        asyncio::Socket old { raw };
+                        expect(old.reuse_port() == 0);
+                        expect(old.bind("127.0.0.1", 23473) == 0);
+                        expect(old.listen(16) == 0);
+                        auto client = [] -> asyncio::Task<> {
+                            asyncio::Socket c;
+                            expect(co_await c.connect("127.0.0.1", 23473) == 0);
+                        }();
+                        close(co_await old.accept());
+                        co_await client;
+                    }
+                    // closed behind the library's back, its registration is stale
+                    close(raw);
+                    asyncio::Socket server;
+                    expect(server.fd() == raw);
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23474) == 0);
+                    expect(server.listen(16) == 0);
+                    auto acceptor = [](asyncio::Socket& server) -> asyncio::Task<> {
+                        auto conn = co_await server.accept();
+                        expect(conn >= 0);
+                        close(conn);
+                    }(server);
+                    // the accept has to wait for the connection
+                    co_await asyncio::sleep<1>();
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23474) == 0);
+                    co_await asyncio::sleep<100>();
+                    expect(acceptor.done()) << "the new fd is watched by epoll";
+                }()
+            );
+        };
+
+#if ASYNCIO_IO_URING
+        given("registered buffer") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto& ring = asyncio::IoUring::get();
+                    auto buffer = ring.acquire_buffer();
+                    if (buffer.empty()) {
+                        co_return;
+                    }
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23460) == 0);
+                    expect(server.listen(16) == 0);
+                    auto client = [](std::span<char> buffer) -> asyncio::Task<> {
+                        asyncio::Socket c;
+                        expect(co_await c.connect("127.0.0.1", 23460) == 0);
+                        std::memcpy(buffer.data(), "registered", 10);
+                        expect(!!co_await c.write(buffer.data(), 10));
+                        auto res = co_await c.read(buffer.data(), buffer.size());
+                        expect(res && *res == 10);
+                        expect(std::string_view(buffer.data(), 10) == "registered");
+                    }(buffer);
+                    auto conn = co_await server.accept();
+                    auto server_task = echo(conn);
+                    co_await client;
+                    ring.release_buffer(buffer);
+                }()
+            );
+        };
+
+        given("registered buffer to a reset peer") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto& ring = asyncio::IoUring::get();
+                    auto buffer = ring.acquire_buffer();
+                    if (buffer.empty()) {
+                        co_return;
+                    }
+                    asyncio::Socket server;
+                    expect(server.reuse_port() == 0);
+                    expect(server.bind("127.0.0.1", 23475) == 0);
+                    expect(server.listen(16) == 0);
+                    asyncio::Socket c;
+                    expect(co_await c.connect("127.0.0.1", 23475) == 0);
+                    auto conn = co_await server.accept();
+                    linger reset { .l_onoff = 1, .l_linger = 0 };
+                    setsockopt(conn, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+                    close(conn);
+                    co_await asyncio::sleep<1>();
+                    // the reset comes first, then EPIPE, both without a SIGPIPE
+                    for (int i = 0; i < 3; ++i) {
+                        expect(!co_await c.write(buffer.data(), 16));
+                    }
+                    ring.release_buffer(buffer);
+                }()
+            );
+        };
+#endif
+    };
+}
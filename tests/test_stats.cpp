@@ -0,0 +1,153 @@
+#include <csignal>
+#include <thread>
+#include <vector>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+
+#include <boost/ut.hpp>
+
+#include "asyncio.hpp"
+using namespace kwa;
+using namespace boost::ut;
+using namespace boost::ut::bdd;
+
+
+int main() noexcept {
+    "stats"_test = [] {
+        given("counters") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            auto before = loop.stats();
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto& loop = asyncio::EventLoop::get();
+                    int fired = 0;
+                    loop.call_later(std::chrono::milliseconds(10), [&fired] { fired++; });
+                    auto timer = loop.call_later(std::chrono::milliseconds(20), [&fired] { fired++; });
+                    timer->cancel();
+                    for (int i = 0; i < 3; ++i) {
+                        co_await asyncio::sleep<0>();
+                    }
+                    co_await asyncio::sleep<30>();
+                    expect(fired == 1);
+                }()
+            );
+            auto after = loop.stats();
+            expect(after.iterations > before.iterations);
+            expect(after.polls > before.polls);
+            expect(after.callbacks >= before.callbacks + 5);
+            expect(after.ready_high_water >= 1u);
+            expect(after.timers_scheduled - before.timers_scheduled == 3u);
+            expect(after.timers_fired - before.timers_fired == 2u);
+            expect(after.timers_canceled - before.timers_canceled == 1u);
+            expect(after.blocked - before.blocked >= std::chrono::milliseconds(20));
+            expect(after.running.count() > before.running.count());
+            expect(after.lag_max.count() >= 0);
+        };
+
+        given("periodic snapshot") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            int snapshots = 0;
+            uint64_t last_iterations = 0;
+            loop.set_stats_callback(
+                std::chrono::milliseconds(10),
+                [&](const asyncio::EventLoop::Stats& stats) {
+                    expect(stats.iterations >= last_iterations);
+                    last_iterations = stats.iterations;
+                    snapshots++;
+                }
+            );
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    co_await asyncio::sleep<55>();
+                }()
+            );
+            loop.set_stats_callback({}, nullptr);
+            expect(snapshots >= 4 and snapshots <= 6) << snapshots;
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    co_await asyncio::sleep<30>();
+                }()
+            );
+            expect(snapshots <= 6) << snapshots;
+        };
+
+        given("slow callback") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            loop.set_slow_callback_duration(std::chrono::milliseconds(5));
+            auto before = loop.stats();
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    co_await asyncio::sleep<1>();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    co_await asyncio::sleep<1>();
+                }()
+            );
+            loop.set_slow_callback_duration({});
+            expect(loop.stats().slow_callbacks - before.slow_callbacks == 1u);
+        };
+
+        given("event batch grows") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            std::vector<int> fds;
+            for (int i = 0; i < MIN_EVENTS_NUM * 3; ++i) {
+                fds.push_back(eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC));
+            }
+            auto before = loop.stats();
+            asyncio::run(
+                [](std::vector<int>& fds) -> asyncio::Task<> {
+                    size_t fired = 0;
+                    for (auto fd : fds) {
+                        asyncio::Epoll::get().add_reader(fd, 0, [&fired] { fired++; });
+                    }
+                    while (fired < fds.size()) {
+                        co_await asyncio::sleep<1>();
+                    }
+                }(fds)
+            );
+            expect(loop.stats().max_events > (size_t)MIN_EVENTS_NUM) << loop.stats().max_events;
+            expect(loop.stats().events - before.events >= fds.size());
+            for (auto fd : fds) {
+                close(fd);
+            }
+        };
+
+        given("callback cap") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            loop.set_max_callbacks(2);
+            auto before = loop.stats();
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto& loop = asyncio::EventLoop::get();
+                    int count = 0;
+                    for (int i = 0; i < 8; ++i) {
+                        loop.call_soon([&count] { count++; });
+                    }
+                    while (count < 8) {
+                        co_await asyncio::sleep<0>();
+                    }
+                }()
+            );
+            loop.set_max_callbacks(0);
+            expect(loop.stats().iterations - before.iterations >= 4u);
+        };
+
+        given("interrupted wait") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            struct sigaction action {};
+            action.sa_handler = [](int) {};
+            sigaction(SIGALRM, &action, nullptr);
+            auto before = loop.stats();
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    itimerval timer { .it_interval = {}, .it_value = { .tv_sec = 0, .tv_usec = 5000 } };
+                    setitimer(ITIMER_REAL, &timer, nullptr);
+                    co_await asyncio::sleep<20>();
+                }()
+            );
+            signal(SIGALRM, SIG_DFL);
+            // the interrupted wait counts as a poll without events
+            expect(loop.stats().max_events <= (size_t)MAX_EVENTS_NUM) << loop.stats().max_events;
+            expect(loop.stats().events - before.events < 16u);
+        };
+    };
+}
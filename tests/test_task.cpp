@@ -21,6 +21,58 @@ asyncio::Task<int64_t> square(int64_t x) {
 }
 
 
+asyncio::LazyTask<int> lazy_depth(int n) {
+    if (n == 0) {
+        co_await asyncio::sleep<1>();
+        co_return 0;
+    }
+    co_return 1 + co_await lazy_depth(n - 1);
+}
+
+
+asyncio::Task<int> depth(int n) {
+    if (n == 0) {
+        co_return 0;
+    }
+    co_return 1 + co_await depth(n - 1);
+}
+
+
+template<typename Alloc>
+asyncio::Task<int64_t> square(std::allocator_arg_t, Alloc, int64_t x) {
+    co_return x * x;
+}
+
+
+template<typename Alloc>
+asyncio::Task<int64_t> square_sum(std::allocator_arg_t, Alloc alloc, int64_t x, int64_t y) {
+    auto x2 = co_await square(std::allocator_arg, alloc, x);
+    auto y2 = co_await square(std::allocator_arg, alloc, y);
+    co_return x2 + y2;
+}
+
+
+/// std::allocator that counts live allocations
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+    int* live;
+
+    CountingAllocator(int* live) noexcept: live(live) {}
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>& alloc) noexcept: live(alloc.live) {}
+    T* allocate(size_t n) {
+        ++*live;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) noexcept {
+        --*live;
+        std::allocator<T>().deallocate(p, n);
+    }
+    bool operator==(const CountingAllocator&) const = default;
+};
+
+
 int main() {
     "task"_test = [] {
         given("simple await") = [] {
@@ -91,4 +143,205 @@ int main() {
             }()
         );
     };
+    "frame pool"_test = [] {
+        auto& pool = asyncio::FramePool::get();
+        auto squares = [] -> asyncio::Task<int64_t> {
+            int64_t sum = 0;
+            for (int64_t i = 0; i < 100; ++i) {
+                sum += co_await square(i);
+            }
+            co_return sum;
+        };
+        expect(asyncio::run(squares()) == 328350);
+        auto before = pool.stats();
+        expect(asyncio::run(squares()) == 328350);
+        auto after = pool.stats();
+        expect(after.misses == before.misses) << "steady state should not allocate";
+        expect(after.hits - before.hits >= 101u);
+
+        pool.clear();
+        expect(pool.stats().cached == 0u);
+        pool.prewarm(100, 4);
+        expect(pool.stats().cached == 4u);
+        pool.prewarm(FRAME_POOL_MAX_SIZE + 1, 4);
+        expect(pool.stats().cached == 4u);
+    };
+
+    "frame allocator"_test = [] {
+        given("arena") = [] {
+            auto& pool = asyncio::FramePool::get();
+            asyncio::Arena arena;
+            auto before = pool.stats();
+            expect(asyncio::run(square_sum(std::allocator_arg, arena.allocator(), 3, 4)) == 25);
+            auto after = pool.stats();
+            expect(after.hits == before.hits and after.misses == before.misses);
+            expect(arena.used() > 0u);
+            arena.reset();
+            expect(arena.used() == 0u);
+            expect(asyncio::run(square_sum(std::allocator_arg, arena.allocator(), 5, 12)) == 169);
+        };
+
+        given("custom allocator") = [] {
+            int live = 0;
+            auto res = asyncio::run(
+                [](int& live) -> asyncio::Task<int64_t> {
+                    auto task = square_sum(std::allocator_arg, CountingAllocator<std::byte>(&live), 3, 4);
+                    expect(live == 1);
+                    co_return co_await task;
+                }(live)
+            );
+            expect(res == 25);
+            expect(live == 0);
+        };
+    };
+
+    "symmetric transfer"_test = [] {
+        auto& loop = asyncio::EventLoop::get();
+        auto before = loop.stats().iterations;
+        expect(asyncio::run(depth(10000)) == 10000);
+        // one iteration to start every child, none to resume the parents
+        expect(loop.stats().iterations - before < 10000u + 10u) << loop.stats().iterations - before;
+    };
+
+    "LazyTask"_test = [] {
+        given("start on await") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    bool started = false;
+                    auto task = [](bool& started) -> asyncio::LazyTask<int64_t> {
+                        started = true;
+                        co_return co_await square(7);
+                    }(started);
+                    co_await asyncio::sleep<1>();
+                    expect(!started);
+                    expect(co_await task == 49);
+                    expect(started and task.done());
+                    auto never = [](bool& started) -> asyncio::LazyTask<> {
+                        started = false;
+                        co_return;
+                    }(started);
+                    co_await asyncio::sleep<1>();
+                    expect(started) << "a lazy task never awaited never runs";
+                }()
+            );
+        };
+
+        given("nested await without queueing") = [] {
+            auto& loop = asyncio::EventLoop::get();
+            auto before = loop.stats().iterations;
+            expect(asyncio::run([] -> asyncio::Task<int> { co_return co_await lazy_depth(10000); }()) == 10000);
+            // the root, the sleep at the bottom and the loop stop
+            expect(loop.stats().iterations - before < 10u) << loop.stats().iterations - before;
+        };
+    };
+
+    "gather and when_any"_test = [] {
+        given("gather") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto a = [] -> asyncio::Task<int> { co_await asyncio::sleep<5>(); co_return 1; }();
+                    auto b = [] -> asyncio::Task<int> { co_await asyncio::sleep<1>(); co_return 2; }();
+                    auto c = square(3);
+                    co_await asyncio::gather(a, b, c);
+                    expect(a.done() and b.done() and c.done());
+                    expect(a.result() + b.result() + c.result() == 12);
+
+                    std::vector<asyncio::Task<int64_t>> tasks;
+                    for (int64_t i = 0; i < 10; ++i) {
+                        tasks.push_back(square(i));
+                    }
+                    co_await asyncio::gather(std::span(tasks));
+                    int64_t sum = 0;
+                    for (auto& task : tasks) {
+                        sum += task.result();
+                    }
+                    expect(sum == 285);
+                }()
+            );
+        };
+
+        given("when_any") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto slow = [] -> asyncio::Task<int> { co_await asyncio::sleep<50>(); co_return 1; }();
+                    auto fast = [] -> asyncio::Task<int> { co_await asyncio::sleep<1>(); co_return 2; }();
+                    expect(co_await asyncio::when_any(slow, fast) == 1u);
+                    expect(fast.done() and !slow.done());
+                    slow.cancel();
+                    expect(co_await asyncio::when_any(slow, fast) == 0u) << "a canceled task counts as finished";
+                }()
+            );
+        };
+    };
+
+    "TaskGroup"_test = [] {
+        given("join all") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::TaskGroup<int64_t> group;
+                    for (int64_t i = 0; i < 10; ++i) {
+                        expect(group.spawn(square(i)) == size_t(i));
+                    }
+                    expect(co_await group.join());
+                    int64_t sum = 0;
+                    for (auto& task : group.tasks()) {
+                        sum += task.result();
+                    }
+                    expect(sum == 285);
+                }()
+            );
+        };
+
+        given("cancel siblings on error") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::TaskGroup<int, int> group;
+                    group.spawn([] -> asyncio::Task<int, int> {
+                        co_await asyncio::sleep<500>();
+                        expect(false);
+                        co_return 0;
+                    }());
+                    group.spawn([] -> asyncio::Task<int, int> {
+                        co_await asyncio::sleep<1>();
+                        co_return std::unexpected(-1);
+                    }());
+                    expect(!co_await group.join());
+                    expect(group.tasks()[0].canceled());
+                    expect(!group.tasks()[1].result().has_value());
+                }()
+            );
+        };
+
+        given("cancel siblings without a joiner") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    asyncio::TaskGroup<int, int> group;
+                    group.spawn([] -> asyncio::Task<int, int> {
+                        co_await asyncio::sleep<500>();
+                        expect(false);
+                        co_return 0;
+                    }());
+                    group.spawn([] -> asyncio::Task<int, int> {
+                        co_await asyncio::sleep<1>();
+                        co_return std::unexpected(-1);
+                    }());
+                    co_await asyncio::sleep<10>();
+                    expect(group.tasks()[0].canceled()) << "canceled at the failure, not at the join";
+                }()
+            );
+        };
+
+        given("spawn a failed task") = [] {
+            asyncio::run(
+                [] -> asyncio::Task<> {
+                    auto failed = [] -> asyncio::Task<int, int> { co_return std::unexpected(-1); }();
+                    co_await failed;
+                    expect(failed.done());
+                    asyncio::TaskGroup<int, int> group;
+                    group.spawn(std::move(failed));
+                    expect(!co_await group.join());
+                }()
+            );
+        };
+    };
 }
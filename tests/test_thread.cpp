@@ -31,4 +31,26 @@ int main() {
             }()
         );
     };
+
+    "call_soon_threadsafe"_test = [] {
+        int count = 0;
+        asyncio::run(
+            [&count] -> asyncio::Task<> {
+                auto& loop = asyncio::EventLoop::get();
+                asyncio::Event<> ev;
+                std::thread producer([&] {
+                    for (int i = 0; i < 10000; i++) {
+                        loop.call_soon_threadsafe([&] {
+                            if (++count == 10000) {
+                                ev.set();
+                            }
+                        });
+                    }
+                });
+                co_await ev.wait();
+                producer.join();
+            }()
+        );
+        expect(count == 10000);
+    };
 }
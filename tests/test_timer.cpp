@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <boost/ut.hpp>
 
 #include "asyncio.hpp"
@@ -5,6 +7,10 @@ using namespace kwa;
 using namespace boost::ut;
 using namespace boost::ut::bdd;
 
+// the timing wheel rounds deadlines up to its tick, two ticks and a couple
+// of milliseconds leave room for that rounding plus scheduler jitter
+constexpr int64_t SLACK_MS = ASYNCIO_TIMER_WHEEL ? 2 * TIMER_WHEEL_TICK_US / 1000 + 2 : 0;
+
 
 int main() noexcept {
     "timer"_test = [] {
@@ -16,7 +22,7 @@ int main() noexcept {
                     loop.call_later(std::chrono::milliseconds(500), [now] {
                         auto t = asyncio::Clock::now();
                         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(t - now);
-                        expect(duration.count() > 500-1 and duration.count() < 500+1) << duration.count();
+                        expect(duration.count() > 500-1 and duration.count() < 500+1+SLACK_MS) << duration.count();
                     });
                     co_await asyncio::sleep<600>();
                 }()
@@ -31,11 +37,108 @@ int main() noexcept {
                     loop.call_at(now + std::chrono::milliseconds(500), [now] {
                         auto t = asyncio::Clock::now();
                         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(t - now);
-                        expect(duration.count() > 500-1 and duration.count() < 500+1) << duration.count();
+                        expect(duration.count() > 500-1 and duration.count() < 500+1+SLACK_MS) << duration.count();
                     });
                     co_await asyncio::sleep<600>();
                 }()
             );
         };
     };
+
+    "timer queue"_test = [] {
+        using namespace std::chrono_literals;
+        struct Node final: asyncio::TimerNode {
+            Node(asyncio::TimePoint when) noexcept { _when = when; }
+            void expire() noexcept override {}
+        };
+        auto expire_all = [](asyncio::TimerQueue& queue, asyncio::TimePoint now) {
+            std::vector<std::unique_ptr<Node>> nodes;
+            for (auto ms : { 300, 5, 70000, 64, 4096, 1, 262144, 4095 }) {
+                nodes.push_back(std::make_unique<Node>(now + std::chrono::milliseconds(ms)));
+                queue.push(*nodes.back());
+            }
+            queue.cancel(*nodes[2]);
+            nodes.pop_back();
+            expect(queue.size() == nodes.size() - 1);
+            std::vector<asyncio::TimerNode*> expired;
+            asyncio::TimePoint last {};
+            size_t fired = 0;
+            for (auto t = now; t <= now + 300s; t += 1ms) {
+                queue.pop_expired(t, expired);
+                for (auto node : expired) {
+                    expect(node->when() <= t) << "timer fired too early";
+                    expect(node->when() >= last) << "timer fired out of order";
+                    expect(!node->scheduled());
+                    last = node->when();
+                }
+                fired += expired.size();
+                expired.clear();
+            }
+            expect(fired == nodes.size() - 1);
+            expect(!nodes[2]->scheduled());
+            expect(queue.size() == 0);
+            expect(!queue.next_when().has_value());
+        };
+        given("heap") = [&] {
+            asyncio::TimerHeap heap;
+            expire_all(heap, asyncio::Clock::now());
+        };
+        given("wheel") = [&] {
+            asyncio::TimerWheel wheel;
+            expire_all(wheel, asyncio::Clock::now());
+        };
+        given("wheel with timer beyond range") = [] {
+            // 1ns tick, the wheel covers 2^36ns (about 68s)
+            asyncio::TimerWheel wheel { 1ns };
+            auto now = asyncio::Clock::now();
+            Node node { now + 100s };
+            wheel.push(node);
+            std::vector<asyncio::TimerNode*> expired;
+            wheel.pop_expired(now + 99s, expired);
+            expect(expired.empty());
+            expect(*wheel.next_when() <= node.when());
+            wheel.pop_expired(now + 100s, expired);
+            expect(expired.size() == 1);
+        };
+    };
+
+    "sleep timer unlinks itself"_test = [] {
+        asyncio::run(
+            [] -> asyncio::Task<> {
+                auto task = [] -> asyncio::Task<> {
+                    co_await asyncio::sleep<100>();
+                    expect(false);
+                }();
+                co_await asyncio::sleep<0>();
+                task.cancel();
+                // destroying the canceled task frees the frame holding the timer node
+                { auto _ = std::move(task); }
+                co_await asyncio::sleep<200>();
+            }()
+        );
+    };
+
+    "handle id generation"_test = [] {
+        asyncio::run(
+            [] -> asyncio::Task<> {
+                auto task = [] -> asyncio::Task<> {
+                    co_await asyncio::sleep<10>();
+                    expect(false);
+                }();
+                auto id = task.id();
+                expect(!asyncio::Handle::canceled(id));
+                task.cancel();
+                expect(asyncio::Handle::canceled(id));
+                { auto _ = std::move(task); }
+                // the freed slot is reused under a new generation
+                auto other = [] -> asyncio::Task<> { co_return; }();
+                expect((uint32_t)other.id() == (uint32_t)id);
+                expect(other.id() != id);
+                expect(asyncio::Handle::canceled(id));
+                expect(!asyncio::Handle::canceled(other.id()));
+                co_await other;
+                co_await asyncio::sleep<20>();
+            }()
+        );
+    };
 }